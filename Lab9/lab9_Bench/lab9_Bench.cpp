@@ -0,0 +1,975 @@
+﻿#include <benchmark/benchmark.h>
+
+#include "../lab9_CoW/Drawer.h"
+#include "../lab9_CoW/Image.h"
+#include "../lab9_CoW/ImageExpr.h"
+#include "../lab9_CoW/ImageStats.h"
+#include "../lab9_CoW/ImageUtils.h"
+#include "../lab9_CoW/PagedImage.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <optional>
+#include <random>
+#include <sstream>
+
+namespace
+{
+	constexpr ImageSize BENCH_SIZE{ 1024, 1024 };
+
+	template <typename ImageT = Image>
+	ImageT MakeNoise(ImageSize size, uint32_t seed)
+	{
+		ImageT img{ size };
+		std::vector<uint32_t> row(static_cast<size_t>(size.width));
+		for (int y = 0; y < size.height; ++y)
+		{
+			for (auto& color : row)
+			{
+				seed = seed * 1664525u + 1013904223u;
+				color = seed;
+			}
+			img.WriteRow(y, row.data());
+		}
+		return img;
+	}
+
+	// уровень SIMD передаётся аргументом бенчмарка и восстанавливается после него
+	class KernelLevelScope
+	{
+	public:
+		explicit KernelLevelScope(const benchmark::State& state)
+		{
+			const auto level = static_cast<SimdLevel>(state.range(0));
+			UsePixelKernels(level);
+		}
+
+		~KernelLevelScope()
+		{
+			UsePixelKernels(GetSupportedSimdLevel());
+		}
+	};
+
+	void SimdLevels(benchmark::internal::Benchmark* bench)
+	{
+		bench->ArgName("simd");
+		for (auto level : { SimdLevel::Scalar, SimdLevel::Sse2, SimdLevel::Avx2 })
+		{
+			if (level <= GetSupportedSimdLevel())
+			{
+				bench->Arg(static_cast<int>(level));
+			}
+		}
+	}
+
+	void SetPixelsProcessed(benchmark::State& state, ImageSize size)
+	{
+		state.SetItemsProcessed(state.iterations() * size.width * size.height);
+	}
+
+	// живые тайлы (по умолчанию - после прогона): сколько их на самом деле
+	// создано при разделении между копиями
+	template <unsigned TileSize = Tile::SIZE>
+	void ReportTileCount(benchmark::State& state, int tiles = BasicTile<TileSize>::GetInstanceCount())
+	{
+		state.counters["tiles"] = tiles;
+	}
+
+	// копирования тайлов при записи за одну итерацию и пик числа тайлов:
+	// рост этих счётчиков - потеря разделения между копиями
+	void ReportCoWStats(benchmark::State& state, const TileSharingStats& stats)
+	{
+		state.counters["copies"] = static_cast<double>(stats.copies.unshareCopies);
+		state.counters["copied_bytes"] = static_cast<double>(stats.copies.bytesCopied);
+		state.counters["shared"] = static_cast<double>(stats.sharedTiles);
+		state.counters["shared_bytes"] = static_cast<double>(stats.sharedBytes);
+		state.counters["peak_tiles"] = Tile::GetPeakInstanceCount();
+	}
+
+	std::vector<Point> MakeRandomPoints(ImageSize size, size_t count)
+	{
+		std::mt19937 rng{ 42 };
+		std::uniform_int_distribution<int> xs{ 0, size.width - 1 };
+		std::uniform_int_distribution<int> ys{ 0, size.height - 1 };
+		std::vector<Point> points(count);
+		for (auto& p : points)
+		{
+			p = { xs(rng), ys(rng) };
+		}
+		return points;
+	}
+
+	void Radii(benchmark::internal::Benchmark* bench)
+	{
+		bench->ArgName("radius");
+		for (int radius : { 8, 64, 256, 500 })
+		{
+			bench->Arg(radius);
+		}
+	}
+}
+
+static void BM_SetPixelSequential(benchmark::State& state)
+{
+	Image img{ BENCH_SIZE };
+	uint32_t color = 1;
+	for (auto _ : state)
+	{
+		for (int y = 0; y < BENCH_SIZE.height; ++y)
+		{
+			for (int x = 0; x < BENCH_SIZE.width; ++x)
+			{
+				img.SetPixel({ x, y }, color + static_cast<uint32_t>(x & 1));
+			}
+		}
+		++color;
+		benchmark::ClobberMemory();
+	}
+	SetPixelsProcessed(state, BENCH_SIZE);
+	ReportTileCount(state);
+}
+BENCHMARK(BM_SetPixelSequential);
+
+static void BM_SetPixelRandom(benchmark::State& state)
+{
+	Image img{ BENCH_SIZE };
+	const auto points = MakeRandomPoints(BENCH_SIZE, 1 << 20);
+	uint32_t color = 1;
+	for (auto _ : state)
+	{
+		for (const auto& p : points)
+		{
+			img.SetPixel(p, color);
+		}
+		++color;
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(points.size()));
+	ReportTileCount(state);
+}
+BENCHMARK(BM_SetPixelRandom);
+
+static void BM_GetPixelSequential(benchmark::State& state)
+{
+	const Image img = MakeNoise(BENCH_SIZE, 9);
+	for (auto _ : state)
+	{
+		uint32_t sum = 0;
+		for (int y = 0; y < BENCH_SIZE.height; ++y)
+		{
+			for (int x = 0; x < BENCH_SIZE.width; ++x)
+			{
+				sum += img.GetPixel({ x, y });
+			}
+		}
+		benchmark::DoNotOptimize(sum);
+	}
+	SetPixelsProcessed(state, BENCH_SIZE);
+	ReportTileCount(state);
+}
+BENCHMARK(BM_GetPixelSequential);
+
+static void BM_GetPixelRandom(benchmark::State& state)
+{
+	const Image img = MakeNoise(BENCH_SIZE, 9);
+	const auto points = MakeRandomPoints(BENCH_SIZE, 1 << 20);
+	for (auto _ : state)
+	{
+		uint32_t sum = 0;
+		for (const auto& p : points)
+		{
+			sum += img.GetPixel(p);
+		}
+		benchmark::DoNotOptimize(sum);
+	}
+	state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(points.size()));
+	ReportTileCount(state);
+}
+BENCHMARK(BM_GetPixelRandom);
+
+static void BM_SumForEachTile(benchmark::State& state)
+{
+	const Image img = MakeNoise(BENCH_SIZE, 9);
+	for (auto _ : state)
+	{
+		uint32_t sum = 0;
+		img.ForEachTile([&sum](const TilePixels<const uint32_t>& tile) {
+			for (int y = 0; y < tile.size.height; ++y)
+			{
+				const uint32_t* row = tile.GetRow(y);
+				for (int x = 0; x < tile.size.width; ++x)
+				{
+					sum += row[x];
+				}
+			}
+		});
+		benchmark::DoNotOptimize(sum);
+	}
+	SetPixelsProcessed(state, BENCH_SIZE);
+}
+BENCHMARK(BM_SumForEachTile);
+
+static void BM_SumForEachRow(benchmark::State& state)
+{
+	const Image img = MakeNoise(BENCH_SIZE, 9);
+	for (auto _ : state)
+	{
+		uint32_t sum = 0;
+		img.ForEachRow([&sum](Point, const uint32_t* pixels, size_t count) {
+			for (size_t i = 0; i < count; ++i)
+			{
+				sum += pixels[i];
+			}
+		});
+		benchmark::DoNotOptimize(sum);
+	}
+	SetPixelsProcessed(state, BENCH_SIZE);
+}
+BENCHMARK(BM_SumForEachRow);
+
+static void BM_InvertForEachTile(benchmark::State& state)
+{
+	Image img = MakeNoise(BENCH_SIZE, 9);
+	for (auto _ : state)
+	{
+		img.ForEachTile([](const TilePixels<uint32_t>& tile) {
+			for (int y = 0; y < tile.size.height; ++y)
+			{
+				uint32_t* row = tile.GetRow(y);
+				for (int x = 0; x < tile.size.width; ++x)
+				{
+					row[x] = ~row[x];
+				}
+			}
+		});
+		benchmark::ClobberMemory();
+	}
+	SetPixelsProcessed(state, BENCH_SIZE);
+}
+BENCHMARK(BM_InvertForEachTile);
+
+static void BM_DrawLine(benchmark::State& state)
+{
+	Image img{ BENCH_SIZE };
+	const int length = static_cast<int>(state.range(0));
+	uint32_t color = 1;
+	for (auto _ : state)
+	{
+		// пологая и крутая линии
+		DrawLine(img, { 0, 10 }, { length, 10 + length / 3 }, color);
+		DrawLine(img, { 10, 0 }, { 10 + length / 3, length }, color);
+		++color;
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * 2 * (length + 1));
+	ReportTileCount(state);
+}
+BENCHMARK(BM_DrawLine)->ArgName("length")->Arg(16)->Arg(256)->Arg(1000);
+
+static void BM_DrawCircle(benchmark::State& state)
+{
+	Image img{ BENCH_SIZE };
+	const int radius = static_cast<int>(state.range(0));
+	uint32_t color = 1;
+	for (auto _ : state)
+	{
+		DrawCircle(img, { BENCH_SIZE.width / 2, BENCH_SIZE.height / 2 }, radius, color++);
+		benchmark::ClobberMemory();
+	}
+	ReportTileCount(state);
+}
+BENCHMARK(BM_DrawCircle)->Apply(Radii);
+
+static void BM_FillCircle(benchmark::State& state)
+{
+	Image img{ BENCH_SIZE };
+	const int radius = static_cast<int>(state.range(0));
+	uint32_t color = 1;
+	for (auto _ : state)
+	{
+		FillCircle(img, { BENCH_SIZE.width / 2, BENCH_SIZE.height / 2 }, radius, color++);
+		benchmark::ClobberMemory();
+	}
+	ReportTileCount(state);
+}
+BENCHMARK(BM_FillCircle)->Apply(Radii);
+
+static void BM_DrawCircleAA(benchmark::State& state)
+{
+	Image img{ BENCH_SIZE };
+	const int radius = static_cast<int>(state.range(0));
+	uint32_t color = 1;
+	for (auto _ : state)
+	{
+		DrawCircleAA(img, { BENCH_SIZE.width / 2, BENCH_SIZE.height / 2 }, radius, color++);
+		benchmark::ClobberMemory();
+	}
+	ReportTileCount(state);
+}
+BENCHMARK(BM_DrawCircleAA)->Apply(Radii);
+
+static void BM_DrawLineAA(benchmark::State& state)
+{
+	Image img{ BENCH_SIZE };
+	const int length = static_cast<int>(state.range(0));
+	uint32_t color = 1;
+	for (auto _ : state)
+	{
+		DrawLineAA(img, { 0, 10 }, { length, 10 + length / 3 }, color++);
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * (length + 1));
+	ReportTileCount(state);
+}
+BENCHMARK(BM_DrawLineAA)->ArgName("length")->Arg(16)->Arg(256)->Arg(1000);
+
+static void BM_DrawThickLine(benchmark::State& state)
+{
+	Image img{ BENCH_SIZE };
+	const int width = static_cast<int>(state.range(0));
+	uint32_t color = 1;
+	for (auto _ : state)
+	{
+		DrawThickLine(img, { 50, 50 }, { 950, 700 }, width, color++, LineCap::Round);
+		benchmark::ClobberMemory();
+	}
+	ReportTileCount(state);
+}
+BENCHMARK(BM_DrawThickLine)->ArgName("width")->Arg(2)->Arg(16)->Arg(64);
+
+// однородная область заливается целыми тайлами
+static void BM_FloodFillUniform(benchmark::State& state)
+{
+	Image img{ BENCH_SIZE };
+	uint32_t color = 1;
+	for (auto _ : state)
+	{
+		FloodFill(img, { 0, 0 }, color++);
+		benchmark::ClobberMemory();
+	}
+	SetPixelsProcessed(state, BENCH_SIZE);
+	ReportTileCount(state);
+}
+BENCHMARK(BM_FloodFillUniform);
+
+// коридор-змейка: тайлы развёрнуты, область ищется попиксельно
+static void BM_FloodFillSerpentine(benchmark::State& state)
+{
+	Image img{ BENCH_SIZE };
+	for (int y = 1; y < BENCH_SIZE.height; y += 2)
+	{
+		const bool gapRight = (y / 2) % 2 == 0;
+		img.FillSpan(y, gapRight ? 0 : 1, gapRight ? BENCH_SIZE.width - 2 : BENCH_SIZE.width - 1, 0xFFFFFF);
+	}
+	uint32_t color = 1;
+	for (auto _ : state)
+	{
+		FloodFill(img, { 0, 0 }, color++);
+		benchmark::ClobberMemory();
+	}
+	SetPixelsProcessed(state, { BENCH_SIZE.width, BENCH_SIZE.height / 2 });
+	ReportTileCount(state);
+}
+BENCHMARK(BM_FloodFillSerpentine);
+
+// вырезание 512 x 512: с угла на границе тайлов тайлы становятся общими,
+// со сдвигом на пиксель пиксели копируются
+static void BM_Crop(benchmark::State& state)
+{
+	const Image img = MakeNoise(BENCH_SIZE, 11);
+	const Rect rect{ { static_cast<int>(state.range(0)), 64 }, { 512, 512 } };
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(img.Crop(rect));
+	}
+	SetPixelsProcessed(state, rect.size);
+}
+BENCHMARK(BM_Crop)->ArgName("x")->Arg(64)->Arg(65);
+
+static void BM_Paste(benchmark::State& state)
+{
+	const Image src = MakeNoise({ 512, 512 }, 12);
+	Image img = MakeNoise(BENCH_SIZE, 13);
+	const Point at{ static_cast<int>(state.range(0)), 64 };
+	for (auto _ : state)
+	{
+		img.Paste(src, at);
+		benchmark::ClobberMemory();
+	}
+	SetPixelsProcessed(state, src.GetImageSize());
+}
+BENCHMARK(BM_Paste)->ArgName("x")->Arg(64)->Arg(65);
+
+// запись и чтение изображения из файла подкачки по строкам: бюджет в строку
+// тайлов обходится без повторных чтений, меньший - подкачивает каждый тайл
+// на каждой его строке пикселей
+static void BM_PagedRows(benchmark::State& state)
+{
+	const size_t budgetTiles = static_cast<size_t>(state.range(0));
+	PagingStats stats;
+	{
+		PagedImage img{ "bench_paged.bin", BENCH_SIZE, budgetTiles * PagedImage::TileStore::TILE_BYTES };
+		std::vector<uint32_t> row(static_cast<size_t>(BENCH_SIZE.width));
+		uint32_t color = 0;
+		for (auto _ : state)
+		{
+			for (int y = 0; y < BENCH_SIZE.height; ++y)
+			{
+				std::fill(row.begin(), row.end(), color++);
+				img.WriteRow(y, row.data());
+			}
+			for (int y = 0; y < BENCH_SIZE.height; ++y)
+			{
+				img.ReadRow(y, row.data());
+			}
+			benchmark::DoNotOptimize(row.data());
+		}
+		stats = img.GetStats();
+	}
+	std::remove("bench_paged.bin");
+
+	state.counters["hits"] = benchmark::Counter(static_cast<double>(stats.hits), benchmark::Counter::kAvgIterations);
+	state.counters["misses"] = benchmark::Counter(static_cast<double>(stats.misses), benchmark::Counter::kAvgIterations);
+	state.counters["writeBacks"] = benchmark::Counter(static_cast<double>(stats.writeBacks), benchmark::Counter::kAvgIterations);
+	SetPixelsProcessed(state, { BENCH_SIZE.width, 2 * BENCH_SIZE.height });
+}
+BENCHMARK(BM_PagedRows)->ArgName("tiles")->Arg(64)->Arg(BENCH_SIZE.width / Tile::SIZE)->Arg(4096);
+
+// копирование изображения и первые записи в копию: копия стоит только
+// счётчиков ссылок, за каждую запись в новый тайл платится копированием тайла
+static void BM_CopyThenFirstWrite(benchmark::State& state)
+{
+	const Image img = MakeNoise(BENCH_SIZE, 10);
+	const int step = static_cast<int>(state.range(0));
+	int tiles = 0;
+	TileSharingStats stats;
+	CoWCounters::Enable();
+	Tile::ResetPeakInstanceCount();
+	for (auto _ : state)
+	{
+		Image copy = img;
+		copy.ResetCoWStats();
+		for (int y = 0; y < BENCH_SIZE.height; y += step)
+		{
+			for (int x = 0; x < BENCH_SIZE.width; x += step)
+			{
+				copy.SetPixel({ x, y }, 0);
+			}
+		}
+		benchmark::DoNotOptimize(copy);
+		tiles = Tile::GetInstanceCount();
+		state.PauseTiming();
+		stats = copy.GetSharingStats();
+		state.ResumeTiming();
+	}
+	CoWCounters::Enable(false);
+	ReportTileCount(state, tiles);
+	ReportCoWStats(state, stats);
+}
+BENCHMARK(BM_CopyThenFirstWrite)->ArgName("step")->Arg(BENCH_SIZE.width)->Arg(64)->Arg(8);
+
+// цена отделения одного тайла. Пиксели развёрнутого тайла лежат отдельно от него,
+// чтобы одноцветный тайл хранил только цвет: копия развёрнутого тайла берёт из
+// пула два блока вместо одного. Для сравнения - тайл с пикселями внутри объекта
+namespace
+{
+	struct InlineTile
+	{
+		using allocator_type = PoolAllocator<InlineTile>;
+
+		std::array<uint32_t, Tile::SIZE * Tile::SIZE> pixels{};
+	};
+}
+
+static void BM_UnshareSolidTile(benchmark::State& state)
+{
+	const CoW<Tile> original{ 0x123456u };
+	for (auto _ : state)
+	{
+		CoW<Tile> copy = original;
+		copy--->SetPixel({ 0, 0 }, 0x123456);
+		benchmark::DoNotOptimize(&*copy);
+	}
+	state.counters["bytes"] = static_cast<double>(original->GetByteSize());
+}
+BENCHMARK(BM_UnshareSolidTile);
+
+static void BM_UnshareExpandedTile(benchmark::State& state)
+{
+	CoW<Tile> original{ 0x123456u };
+	original--->SetPixel({ 1, 1 }, 0);
+	for (auto _ : state)
+	{
+		CoW<Tile> copy = original;
+		copy--->SetPixel({ 0, 0 }, 0);
+		benchmark::DoNotOptimize(&*copy);
+	}
+	state.counters["bytes"] = static_cast<double>(original->GetByteSize());
+}
+BENCHMARK(BM_UnshareExpandedTile);
+
+static void BM_UnshareInlineTile(benchmark::State& state)
+{
+	CoW<InlineTile> original;
+	for (auto _ : state)
+	{
+		CoW<InlineTile> copy = original;
+		copy--->pixels[0] = 0;
+		benchmark::DoNotOptimize(&*copy);
+	}
+	state.counters["bytes"] = static_cast<double>(sizeof(InlineTile));
+}
+BENCHMARK(BM_UnshareInlineTile);
+
+static void BM_ExportPlain(benchmark::State& state)
+{
+	const Image img = MakeNoise(BENCH_SIZE, 11);
+	const std::string path = "bench_plain.ppm";
+	for (auto _ : state)
+	{
+		SaveImage(img, path, PpmFormat::Plain);
+	}
+	std::remove(path.c_str());
+	SetPixelsProcessed(state, BENCH_SIZE);
+	ReportTileCount(state);
+}
+BENCHMARK(BM_ExportPlain);
+
+static void BM_ImportPlain(benchmark::State& state)
+{
+	const std::string path = "bench_plain.ppm";
+	SaveImage(MakeNoise(BENCH_SIZE, 11), path, PpmFormat::Plain);
+	int tiles = 0;
+	for (auto _ : state)
+	{
+		Image img = ImportImage(path);
+		benchmark::DoNotOptimize(img);
+		tiles = Tile::GetInstanceCount();
+	}
+	std::remove(path.c_str());
+	SetPixelsProcessed(state, BENCH_SIZE);
+	ReportTileCount(state, tiles);
+}
+BENCHMARK(BM_ImportPlain);
+
+static void BM_EncodeQoi(benchmark::State& state)
+{
+	const Image img = MakeNoise(BENCH_SIZE, 11);
+	size_t bytes = 0;
+	for (auto _ : state)
+	{
+		std::ostringstream out;
+		EncodeQoi(img, out);
+		bytes = out.str().size();
+	}
+	SetPixelsProcessed(state, BENCH_SIZE);
+	state.counters["bytes"] = static_cast<double>(bytes);
+}
+BENCHMARK(BM_EncodeQoi);
+
+static void BM_DecodeQoi(benchmark::State& state)
+{
+	std::ostringstream out;
+	EncodeQoi(MakeNoise(BENCH_SIZE, 11), out);
+	const std::string data = out.str();
+	int tiles = 0;
+	for (auto _ : state)
+	{
+		std::istringstream in{ data };
+		Image img = DecodeQoi(in);
+		benchmark::DoNotOptimize(img);
+		tiles = Tile::GetInstanceCount();
+	}
+	SetPixelsProcessed(state, BENCH_SIZE);
+	ReportTileCount(state, tiles);
+}
+BENCHMARK(BM_DecodeQoi);
+
+namespace
+{
+	const auto ThresholdColor = [](uint32_t color) {
+		const uint32_t luma = ((color >> 16 & 0xFF) * 77 + (color >> 8 & 0xFF) * 150 + (color & 0xFF) * 29) >> 8;
+		return luma >= 128 ? 0xFFFFFFFFu : 0xFF000000u;
+	};
+}
+
+// recolor, overlay, threshold отдельными проходами по изображению
+static void BM_PipelinePasses(benchmark::State& state)
+{
+	const Image src = MakeNoise(BENCH_SIZE, 3);
+	const Image overlay = MakeNoise({ 512, 512 }, 4);
+	for (auto _ : state)
+	{
+		Image img = src;
+		img.ReplaceColor(0xFF000000, 0xFFFFFFFF);
+		img.ForEachTile([](TilePixels<uint32_t> tile) {
+			for (int y = 0; y < tile.size.height; ++y)
+			{
+				uint32_t* row = tile.GetRow(y);
+				std::transform(row, row + tile.size.width, row, [](uint32_t color) { return color ^ 0x00FFFFFF; });
+			}
+		});
+		img.Blend(overlay, { 100, 100 });
+		img.ForEachTile([](TilePixels<uint32_t> tile) {
+			for (int y = 0; y < tile.size.height; ++y)
+			{
+				uint32_t* row = tile.GetRow(y);
+				std::transform(row, row + tile.size.width, row, ThresholdColor);
+			}
+		});
+		benchmark::DoNotOptimize(img);
+	}
+	SetPixelsProcessed(state, BENCH_SIZE);
+}
+BENCHMARK(BM_PipelinePasses);
+
+// те же шаги одним проходом по тайлам, threads = 0 - без пула
+static void BM_PipelineFused(benchmark::State& state)
+{
+	const Image src = MakeNoise(BENCH_SIZE, 3);
+	const Image overlay = MakeNoise({ 512, 512 }, 4);
+	ImageExpr expr{ src };
+	expr.ReplaceColor(0xFF000000, 0xFFFFFFFF).Invert().Blend(overlay, { 100, 100 }).Map(ThresholdColor);
+	std::optional<ThreadPool> pool;
+	if (state.range(0) > 0)
+	{
+		pool.emplace(static_cast<unsigned>(state.range(0)));
+	}
+	for (auto _ : state)
+	{
+		Image img = pool ? expr.Evaluate(*pool) : expr.Evaluate();
+		benchmark::DoNotOptimize(img);
+	}
+	SetPixelsProcessed(state, BENCH_SIZE);
+}
+BENCHMARK(BM_PipelineFused)->ArgName("threads")->Arg(0)->Arg(4);
+
+static void BM_BlendPerPixel(benchmark::State& state)
+{
+	Image dst = MakeNoise(BENCH_SIZE, 1);
+	const Image src = MakeNoise(BENCH_SIZE, 2);
+	for (auto _ : state)
+	{
+		for (int y = 0; y < BENCH_SIZE.height; ++y)
+		{
+			for (int x = 0; x < BENCH_SIZE.width; ++x)
+			{
+				dst.SetPixel({ x, y }, BlendPixel(dst.GetPixel({ x, y }), src.GetPixel({ x, y })));
+			}
+		}
+		benchmark::ClobberMemory();
+	}
+	SetPixelsProcessed(state, BENCH_SIZE);
+}
+BENCHMARK(BM_BlendPerPixel);
+
+static void BM_BlendImage(benchmark::State& state)
+{
+	KernelLevelScope scope{ state };
+	Image dst = MakeNoise(BENCH_SIZE, 1);
+	const Image src = MakeNoise(BENCH_SIZE, 2);
+	for (auto _ : state)
+	{
+		dst.Blend(src, { 0, 0 });
+		benchmark::ClobberMemory();
+	}
+	SetPixelsProcessed(state, BENCH_SIZE);
+}
+BENCHMARK(BM_BlendImage)->Apply(SimdLevels);
+
+static void BM_BlitPerPixel(benchmark::State& state)
+{
+	Image dst = MakeNoise(BENCH_SIZE, 1);
+	const Image src = MakeNoise(BENCH_SIZE, 2);
+	for (auto _ : state)
+	{
+		for (int y = 0; y < BENCH_SIZE.height; ++y)
+		{
+			for (int x = 0; x < BENCH_SIZE.width; ++x)
+			{
+				dst.SetPixel({ x + 3, y + 3 }, src.GetPixel({ x, y }));
+			}
+		}
+		benchmark::ClobberMemory();
+	}
+	SetPixelsProcessed(state, BENCH_SIZE);
+}
+BENCHMARK(BM_BlitPerPixel);
+
+static void BM_BlitImage(benchmark::State& state)
+{
+	KernelLevelScope scope{ state };
+	Image dst = MakeNoise(BENCH_SIZE, 1);
+	const Image src = MakeNoise(BENCH_SIZE, 2);
+	for (auto _ : state)
+	{
+		dst.Blit(src, { 3, 3 });
+		benchmark::ClobberMemory();
+	}
+	SetPixelsProcessed(state, BENCH_SIZE);
+}
+BENCHMARK(BM_BlitImage)->Apply(SimdLevels);
+
+static void BM_ReplacePerPixel(benchmark::State& state)
+{
+	Image img = MakeNoise(BENCH_SIZE, 3);
+	img.FillRect({ 0, 0 }, { BENCH_SIZE.width / 2, BENCH_SIZE.height - 1 }, 0xFF00FF);
+	uint32_t key = 0xFF00FF;
+	uint32_t color = 0x00FF00;
+	for (auto _ : state)
+	{
+		for (int y = 0; y < BENCH_SIZE.height; ++y)
+		{
+			for (int x = 0; x < BENCH_SIZE.width; ++x)
+			{
+				if (img.GetPixel({ x, y }) == key)
+				{
+					img.SetPixel({ x, y }, color);
+				}
+			}
+		}
+		std::swap(key, color);
+		benchmark::ClobberMemory();
+	}
+	SetPixelsProcessed(state, BENCH_SIZE);
+}
+BENCHMARK(BM_ReplacePerPixel);
+
+static void BM_ReplaceColor(benchmark::State& state)
+{
+	KernelLevelScope scope{ state };
+	Image img = MakeNoise(BENCH_SIZE, 3);
+	// наполовину цветовой ключ, но тайлы развёрнуты
+	for (int y = 0; y < BENCH_SIZE.height; ++y)
+	{
+		img.FillSpan(y, 0, BENCH_SIZE.width / 2, 0xFF00FF);
+		img.SetPixel({ 0, y }, 1);
+	}
+	uint32_t key = 0xFF00FF;
+	uint32_t color = 0x00FF00;
+	for (auto _ : state)
+	{
+		img.ReplaceColor(key, color);
+		std::swap(key, color);
+		benchmark::ClobberMemory();
+	}
+	SetPixelsProcessed(state, BENCH_SIZE);
+}
+BENCHMARK(BM_ReplaceColor)->Apply(SimdLevels);
+
+static void BM_HistogramPerPixel(benchmark::State& state)
+{
+	const Image img = MakeNoise(BENCH_SIZE, 5);
+	for (auto _ : state)
+	{
+		ImageHistogram histogram;
+		for (int y = 0; y < BENCH_SIZE.height; ++y)
+		{
+			for (int x = 0; x < BENCH_SIZE.width; ++x)
+			{
+				const uint32_t color = img.GetPixel({ x, y });
+				for (size_t channel = 0; channel < 4; ++channel)
+				{
+					++histogram.bins[channel][color >> (8 * channel) & 0xFF];
+				}
+			}
+		}
+		benchmark::DoNotOptimize(histogram);
+	}
+	SetPixelsProcessed(state, BENCH_SIZE);
+}
+BENCHMARK(BM_HistogramPerPixel);
+
+static void BM_ComputeHistogram(benchmark::State& state)
+{
+	KernelLevelScope scope{ state };
+	const Image img = MakeNoise(BENCH_SIZE, 5);
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(ComputeHistogram(img));
+	}
+	SetPixelsProcessed(state, BENCH_SIZE);
+}
+BENCHMARK(BM_ComputeHistogram)->Apply(SimdLevels);
+
+// рисунок: одноцветные тайлы и развёрнутые с длинными заливками
+static void BM_ComputeHistogramDrawn(benchmark::State& state)
+{
+	KernelLevelScope scope{ state };
+	Image img{ BENCH_SIZE, 0xFFFFFFFF };
+	std::mt19937 rng{ 6 };
+	for (int i = 0; i < 200; ++i)
+	{
+		FillCircle(img, { static_cast<int>(rng() % 1024), static_cast<int>(rng() % 1024) },
+			static_cast<int>(rng() % 60), static_cast<uint32_t>(rng()));
+	}
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(ComputeHistogram(img));
+	}
+	SetPixelsProcessed(state, BENCH_SIZE);
+	ReportTileCount(state);
+}
+BENCHMARK(BM_ComputeHistogramDrawn)->Apply(SimdLevels);
+
+// заливка без первого столбца: тайлы не сворачиваются в один цвет
+static void BM_FillPerPixel(benchmark::State& state)
+{
+	Image img = MakeNoise(BENCH_SIZE, 4);
+	uint32_t color = 0;
+	for (auto _ : state)
+	{
+		for (int y = 0; y < BENCH_SIZE.height; ++y)
+		{
+			for (int x = 1; x < BENCH_SIZE.width; ++x)
+			{
+				img.SetPixel({ x, y }, color);
+			}
+		}
+		++color;
+		benchmark::ClobberMemory();
+	}
+	SetPixelsProcessed(state, BENCH_SIZE);
+}
+BENCHMARK(BM_FillPerPixel);
+
+static void BM_FillKernel(benchmark::State& state)
+{
+	KernelLevelScope scope{ state };
+	const auto& kernels = GetPixelKernels();
+	std::vector<uint32_t> pixels(static_cast<size_t>(BENCH_SIZE.width) * BENCH_SIZE.height);
+	uint32_t color = 0;
+	for (auto _ : state)
+	{
+		kernels.fill(pixels.data(), pixels.size(), color++);
+		benchmark::ClobberMemory();
+	}
+	SetPixelsProcessed(state, BENCH_SIZE);
+}
+BENCHMARK(BM_FillKernel)->Apply(SimdLevels);
+
+// полное построение пирамиды: копия без кэша уровней строит все уровни заново
+static void BM_BuildPyramid(benchmark::State& state)
+{
+	KernelLevelScope scope{ state };
+	const auto filter = static_cast<PyramidFilter>(state.range(1));
+	const Image img = MakeNoise(BENCH_SIZE, 9);
+	for (auto _ : state)
+	{
+		const Image copy = img;
+		benchmark::DoNotOptimize(copy.BuildPyramid(filter));
+	}
+	SetPixelsProcessed(state, BENCH_SIZE);
+}
+BENCHMARK(BM_BuildPyramid)->Apply([](benchmark::internal::Benchmark* bench) {
+	bench->ArgNames({ "simd", "bilinear" });
+	for (auto level : { SimdLevel::Scalar, SimdLevel::Sse2, SimdLevel::Avx2 })
+	{
+		if (level <= GetSupportedSimdLevel())
+		{
+			bench->Args({ static_cast<int>(level), static_cast<int>(PyramidFilter::Box) });
+			bench->Args({ static_cast<int>(level), static_cast<int>(PyramidFilter::Bilinear) });
+		}
+	}
+});
+
+// после записи одного пикселя пересчитывается только его цепочка тайлов по уровням
+static void BM_UpdatePyramidAfterEdit(benchmark::State& state)
+{
+	Image img = MakeNoise(BENCH_SIZE, 10);
+	img.BuildPyramid();
+	const auto points = MakeRandomPoints(BENCH_SIZE, 1024);
+	size_t next = 0;
+	for (auto _ : state)
+	{
+		img.SetPixel(points[next++ % points.size()], 0);
+		benchmark::DoNotOptimize(img.BuildPyramid());
+	}
+}
+BENCHMARK(BM_UpdatePyramidAfterEdit);
+
+// матрица размеров тайла: одни и те же операции над BasicImage<8, 16, 32, 64>
+#define TILE_SIZE_BENCHMARK(func) \
+	BENCHMARK_TEMPLATE(func, 8); \
+	BENCHMARK_TEMPLATE(func, 16); \
+	BENCHMARK_TEMPLATE(func, 32); \
+	BENCHMARK_TEMPLATE(func, 64)
+
+template <unsigned TileSize>
+static void BM_TileSizeSetPixel(benchmark::State& state)
+{
+	auto img = MakeNoise<BasicImage<TileSize>>(BENCH_SIZE, 5);
+	uint32_t color = 0;
+	for (auto _ : state)
+	{
+		for (int y = 0; y < BENCH_SIZE.height; ++y)
+		{
+			for (int x = 0; x < BENCH_SIZE.width; ++x)
+			{
+				img.SetPixel({ x, y }, color);
+			}
+		}
+		++color;
+		benchmark::ClobberMemory();
+	}
+	SetPixelsProcessed(state, BENCH_SIZE);
+	ReportTileCount<TileSize>(state);
+}
+TILE_SIZE_BENCHMARK(BM_TileSizeSetPixel);
+
+template <unsigned TileSize>
+static void BM_TileSizeFillCircle(benchmark::State& state)
+{
+	auto img = MakeNoise<BasicImage<TileSize>>(BENCH_SIZE, 6);
+	uint32_t color = 0;
+	for (auto _ : state)
+	{
+		FillCircle(img, { BENCH_SIZE.width / 2, BENCH_SIZE.height / 2 }, 400, color++);
+		benchmark::ClobberMemory();
+	}
+	ReportTileCount<TileSize>(state);
+}
+TILE_SIZE_BENCHMARK(BM_TileSizeFillCircle);
+
+// копия изображения и по одной записи в каждые 64x64 пикселя:
+// чем крупнее тайл, тем меньше тайлов копирует CoW, но тем дороже каждый
+template <unsigned TileSize>
+static void BM_TileSizeCopyThenWrite(benchmark::State& state)
+{
+	const auto img = MakeNoise<BasicImage<TileSize>>(BENCH_SIZE, 7);
+	int tiles = 0;
+	for (auto _ : state)
+	{
+		auto copy = img;
+		for (int y = 0; y < BENCH_SIZE.height; y += 64)
+		{
+			for (int x = 0; x < BENCH_SIZE.width; x += 64)
+			{
+				copy.SetPixel({ x, y }, 0);
+			}
+		}
+		benchmark::DoNotOptimize(copy);
+		tiles = BasicTile<TileSize>::GetInstanceCount();
+	}
+	ReportTileCount<TileSize>(state, tiles);
+}
+TILE_SIZE_BENCHMARK(BM_TileSizeCopyThenWrite);
+
+template <unsigned TileSize>
+static void BM_TileSizeExportImport(benchmark::State& state)
+{
+	const auto img = MakeNoise<BasicImage<TileSize>>(BENCH_SIZE, 8);
+	const std::string path = "bench_tile_size.ppm";
+	for (auto _ : state)
+	{
+		SaveImage(img, path);
+		auto loaded = ImportImage<BasicImage<TileSize>>(path);
+		benchmark::DoNotOptimize(loaded);
+	}
+	std::remove(path.c_str());
+	SetPixelsProcessed(state, BENCH_SIZE);
+}
+TILE_SIZE_BENCHMARK(BM_TileSizeExportImport);
+
+BENCHMARK_MAIN();
\ No newline at end of file
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+
+//      :   ,   
+//   
+struct QueueStats
+{
+	size_t capacity = 0;
+	size_t pushed = 0;
+	size_t maxSize = 0;
+	//   ,   
+	double averageSize = 0;
+	//       - 
+	std::chrono::steady_clock::duration pushWait{};
+	std::chrono::steady_clock::duration popWait{};
+};
+
+//    : Push   , Pop - .
+//  Close()    ,  Pop  nullopt,
+//   
+template <typename T>
+class BoundedQueue
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	explicit BoundedQueue(size_t capacity)
+		: m_capacity(capacity)
+	{
+		if (capacity == 0)
+		{
+			throw std::invalid_argument("Queue capacity must be positive");
+		}
+	}
+
+	BoundedQueue(const BoundedQueue&) = delete;
+	BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+	void Push(T value)
+	{
+		const auto start = Clock::now();
+		std::unique_lock lock{ m_mutex };
+		m_notFull.wait(lock, [this] { return m_items.size() < m_capacity || m_closed; });
+		if (m_closed)
+		{
+			throw std::logic_error("Queue is closed");
+		}
+
+		const auto now = Clock::now();
+		m_stats.pushWait += now - start;
+		Resize(now, [&] { m_items.push_back(std::move(value)); });
+		++m_stats.pushed;
+		m_stats.maxSize = std::max(m_stats.maxSize, m_items.size());
+		lock.unlock();
+		m_notEmpty.notify_one();
+	}
+
+	std::optional<T> Pop()
+	{
+		const auto start = Clock::now();
+		std::unique_lock lock{ m_mutex };
+		m_notEmpty.wait(lock, [this] { return !m_items.empty() || m_closed; });
+
+		const auto now = Clock::now();
+		m_stats.popWait += now - start;
+		if (m_items.empty()) return std::nullopt;
+
+		std::optional<T> value;
+		Resize(now, [&] {
+			value.emplace(std::move(m_items.front()));
+			m_items.pop_front();
+		});
+		lock.unlock();
+		m_notFull.notify_one();
+		return value;
+	}
+
+	void Close()
+	{
+		{
+			std::lock_guard lock{ m_mutex };
+			m_closed = true;
+		}
+		m_notEmpty.notify_all();
+		m_notFull.notify_all();
+	}
+
+	QueueStats GetStats() const
+	{
+		std::lock_guard lock{ m_mutex };
+		auto stats = m_stats;
+		stats.capacity = m_capacity;
+		//      
+		const auto now = m_closed && m_items.empty() ? m_changed : Clock::now();
+		const std::chrono::duration<double> total = now - m_created;
+		const std::chrono::duration<double> current = now - m_changed;
+		if (total.count() > 0)
+		{
+			stats.averageSize = (m_sizeSeconds + current.count() * static_cast<double>(m_items.size())) / total.count();
+		}
+		return stats;
+	}
+
+private:
+	//        ,   
+	template <typename Change>
+	void Resize(Clock::time_point now, Change&& change)
+	{
+		m_sizeSeconds += std::chrono::duration<double>(now - m_changed).count() * static_cast<double>(m_items.size());
+		m_changed = now;
+		change();
+	}
+
+	const size_t m_capacity;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_notEmpty;
+	std::condition_variable m_notFull;
+	std::deque<T> m_items;
+	bool m_closed = false;
+
+	QueueStats m_stats;
+	const Clock::time_point m_created = Clock::now();
+	Clock::time_point m_changed = m_created;
+	double m_sizeSeconds = 0;
+};
\ No newline at end of file
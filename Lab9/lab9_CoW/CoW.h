@@ -1,20 +1,135 @@
 #pragma once
 
+#include <atomic>
 #include <cassert>
+#include <cstdint>
 #include <memory>
+#include <optional>
+#include <type_traits>
 
 //   
 //  
 
+// T      T::allocator_type,
+//   std::allocator
+template <typename T, typename = void>
+struct CoWAllocator
+{
+	using type = std::allocator<T>;
+};
+
 template <typename T>
+struct CoWAllocator<T, std::void_t<typename T::allocator_type>>
+{
+	using type = typename T::allocator_type;
+};
+
+//  CoW ,         
+
+//       
+struct SingleThreadOwnership
+{
+	template <typename T>
+	static bool IsUnique(const std::shared_ptr<T>& shared) noexcept
+	{
+		return shared.use_count() == 1;
+	}
+};
+
+//    . use_count()   :
+//  1,     ,    
+//     (  - release-)
+struct ConcurrentOwnership
+{
+	template <typename T>
+	static bool IsUnique(const std::shared_ptr<T>& shared) noexcept
+	{
+		if (shared.use_count() != 1) return false;
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return true;
+	}
+};
+
+// T      GetByteSize(),  
+//  ,   ,   sizeof(T)
+template <typename T, typename = void>
+struct CoWByteSize
+{
+	static uint64_t Get(const T&) noexcept
+	{
+		return sizeof(T);
+	}
+};
+
+template <typename T>
+struct CoWByteSize<T, std::void_t<decltype(std::declval<const T&>().GetByteSize())>>
+{
+	static uint64_t Get(const T& object) noexcept
+	{
+		return object.GetByteSize();
+	}
+};
+
+struct CoWStats
+{
+	uint64_t unshareCopies = 0;
+	uint64_t bytesCopied = 0;
+};
+
+//      CoW   Reset().   :
+//       
+class CoWCounters
+{
+public:
+	static void Enable(bool enable = true) noexcept
+	{
+		m_enabled.store(enable, std::memory_order_relaxed);
+	}
+
+	static bool IsEnabled() noexcept
+	{
+		return m_enabled.load(std::memory_order_relaxed);
+	}
+
+	static CoWStats Get() noexcept
+	{
+		return { m_unshareCopies.load(std::memory_order_relaxed), m_bytesCopied.load(std::memory_order_relaxed) };
+	}
+
+	static void Reset() noexcept
+	{
+		m_unshareCopies.store(0, std::memory_order_relaxed);
+		m_bytesCopied.store(0, std::memory_order_relaxed);
+	}
+
+	static void AddCopy(uint64_t bytes) noexcept
+	{
+		m_unshareCopies.fetch_add(1, std::memory_order_relaxed);
+		m_bytesCopied.fetch_add(bytes, std::memory_order_relaxed);
+	}
+
+private:
+	inline static std::atomic<bool> m_enabled{};
+	inline static std::atomic<uint64_t> m_unshareCopies{};
+	inline static std::atomic<uint64_t> m_bytesCopied{};
+};
+
+template <typename T, typename Ownership = ConcurrentOwnership>
 class CoW
 {
+	template <typename, typename>
+	friend class CoW;
+
+	using Allocator = typename CoWAllocator<T>::type;
+
+	//     shared_ptr   
 	template <typename U>
 	struct CopyConstr
 	{
-		static std::unique_ptr<U> Copy(const U& other)
+		static std::shared_ptr<U> Copy(const U& other)
 		{
-			return std::make_unique<T>(other);
+			return std::allocate_shared<U>(Allocator{}, other);
 		}
 	};
 
@@ -57,27 +172,53 @@ class CoW
 	};
 
 public:
+	// ,    :    
+	//   
+	class Weak
+	{
+	public:
+		// ,    
+		std::optional<CoW> Lock() const
+		{
+			auto shared = m_weak.lock();
+			if (!shared) return std::nullopt;
+			return CoW{ AdoptTag{}, std::move(shared) };
+		}
+
+		bool IsExpired() const noexcept
+		{
+			return m_weak.expired();
+		}
+
+	private:
+		friend class CoW;
+
+		explicit Weak(const std::shared_ptr<T>& shared) : m_weak(shared) {}
+
+		std::weak_ptr<T> m_weak;
+	};
+
 	template <typename... Args, typename = std::enable_if<!std::is_abstract<T>::value>::type>
 	CoW(Args&&... args)
-		: m_shared(std::make_shared<T>(std::forward<Args>(args)...))
+		: m_shared(std::allocate_shared<T>(Allocator{}, std::forward<Args>(args)...))
 	{}
 
 	// avoid duplicate object
-	CoW(CoW<T>&& rhs) : m_shared(std::move(rhs.m_shared)) {}
+	CoW(CoW&& rhs) : m_shared(std::move(rhs.m_shared)) {}
 
 	CoW(std::unique_ptr<T> pUniqueObj) : m_shared(std::move(pUniqueObj)) {}
 
-	CoW& operator=(CoW<T>&& rhs)
+	CoW& operator=(CoW&& rhs)
 	{
 		m_shared = std::move(rhs.m_shared);
 		return *this;
 	}
 
 	template <typename U>
-	CoW(CoW<U>& rhs) : m_shared(rhs.m_shared) {}
+	CoW(CoW<U, Ownership>& rhs) : m_shared(rhs.m_shared) {}
 
 	template <typename U>
-	CoW& operator=(CoW<U>& rhs)
+	CoW& operator=(CoW<U, Ownership>& rhs)
 	{
 		m_shared = rhs.m_shared;
 		return *this;
@@ -126,14 +267,36 @@ public:
 		return m_shared.use_count();
 	}
 
+	bool IsSharedWith(CoW const& other) const noexcept
+	{
+		return m_shared == other.m_shared;
+	}
+
+	Weak GetWeak() const noexcept
+	{
+		return Weak{ m_shared };
+	}
+
 private:
+	struct AdoptTag {};
+
+	CoW(AdoptTag, std::shared_ptr<T> shared) : m_shared(std::move(shared)) {}
+
 	void EnsureUnique()
 	{
-		if (m_shared.use_count() != 1)
+		if (!Ownership::IsUnique(m_shared))
 		{
 			m_shared = CopyClass::Copy(*m_shared);
+			if (CoWCounters::IsEnabled())
+			{
+				CoWCounters::AddCopy(CoWByteSize<T>::Get(*m_shared));
+			}
 		}
 	}
 
 	std::shared_ptr<T> m_shared;
-};
\ No newline at end of file
+};
+
+//    :     ,   
+template <typename T>
+using ConcurrentCoW = CoW<T, ConcurrentOwnership>;
\ No newline at end of file
@@ -1,6 +1,14 @@
 #include "Drawer.h"
+#include "PagedImage.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <cstdlib>
+#include <numbers>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
 
 namespace
 {
@@ -9,7 +17,9 @@ namespace
 		return (0 < val) - (val < 0);
 	}
 
-	void DrawSteepLine(Image& img, Point from, Point to, uint32_t color)
+	// Target - Image     SetPixel  FillSpan
+	template <typename Target>
+	void DrawSteepLine(Target& img, Point from, Point to, uint32_t color)
 	{
 		const int deltaX = std::abs(to.x - from.x);
 		const int deltaY = std::abs(to.y - from.y);
@@ -40,7 +50,8 @@ namespace
 		}
 	}
 
-	void DrawSlopeLine(Image& image, Point from, Point to, uint32_t color)
+	template <typename Target>
+	void DrawSlopeLine(Target& image, Point from, Point to, uint32_t color)
 	{
 		const int deltaX = std::abs(to.x - from.x);
 		const int deltaY = std::abs(to.y - from.y);
@@ -55,13 +66,20 @@ namespace
 		const int errorThreshold = deltaX + 1;
 		const int deltaErr = deltaY + 1;
 
+		//    y   
 		int error = deltaErr / 2;
+		int spanStart = from.x;
 		for (Point p = from; p.x <= to.x; ++p.x)
 		{
-			image.SetPixel({ p.x, p.y }, color);
 			assert((p.x != to.x) || (p.y == to.y));
 
 			error += deltaErr;
+			if (error >= errorThreshold || p.x == to.x)
+			{
+				image.FillSpan(p.y, spanStart, p.x, color);
+				spanStart = p.x + 1;
+			}
+
 			if (error >= errorThreshold)
 			{
 				p.y += stepY;
@@ -70,26 +88,24 @@ namespace
 		}
 	}
 
-} // namespace
-
-void DrawLine(Image& img, Point from, Point to, uint32_t color)
-{
-	const int deltaX = std::abs(to.x - from.x);
-	const int deltaY = std::abs(to.y - from.y);
-
-	if (deltaY > deltaX)
-	{
-		DrawSteepLine(img, from, to, color);
-	}
-	else
+	template <typename Target>
+	void RasterizeLine(Target& img, Point from, Point to, uint32_t color)
 	{
-		DrawSlopeLine(img, from, to, color);
+		const int deltaX = std::abs(to.x - from.x);
+		const int deltaY = std::abs(to.y - from.y);
+
+		if (deltaY > deltaX)
+		{
+			DrawSteepLine(img, from, to, color);
+		}
+		else
+		{
+			DrawSlopeLine(img, from, to, color);
+		}
 	}
-}
 
-namespace
-{
-	void DrawCirclePoints(Image& img, Point c, int x, int y, uint32_t color)
+	template <typename Target>
+	void DrawCirclePoints(Target& img, Point c, int x, int y, uint32_t color)
 	{
 		img.SetPixel({ c.x + x, c.y + y }, color);
 		img.SetPixel({ c.x - x, c.y + y }, color);
@@ -101,19 +117,393 @@ namespace
 		img.SetPixel({ c.x - y, c.y - x }, color);
 	}
 
-	void FillCirclePoints(Image& img, Point c, int x, int y, uint32_t color)
+	template <typename Target>
+	void FillCirclePoints(Target& img, Point c, int x, int y, uint32_t color)
+	{
+		img.FillSpan(c.y + y, c.x - x, c.x + x, color);
+		img.FillSpan(c.y - y, c.x - x, c.x + x, color);
+
+		//    (   )
+		img.FillSpan(c.y + x, c.x - y, c.x + y, color);
+		img.FillSpan(c.y - x, c.x - y, c.x + y, color);
+	}
+
+	template <typename Target>
+	void RasterizeCircle(Target& img, Point center, int radius, uint32_t color)
 	{
-		for (int xx = c.x - x; xx <= c.x + x; ++xx)
+		if (radius < 0) return;
+	
+		int x{};
+		int y = radius;
+		int d = 3 - 2 * radius; //  
+
+		// 4, 6, 10 -      x*x + y*y <= r*r
+		while (y >= x)
 		{
-			img.SetPixel({ xx, c.y + y }, color);
-			img.SetPixel({ xx, c.y - y }, color);
+			DrawCirclePoints(img, center, x, y, color);
+			if (d <= 0)
+			{
+				d += 4 * x + 6;
+			}
+			else
+			{
+				d += 4 * (x - y) + 10;
+				--y;
+			}
+			++x;
 		}
+	}
 
-		//    (   )
-		for (int xx = c.x - y; xx <= c.x + y; ++xx)
+	template <typename Target>
+	void RasterizeFilledCircle(Target& image, Point center, int radius, uint32_t color)
+	{
+		if (radius < 0) return;
+
+		int x{};
+		int y = radius;
+		int d = 3 - 2 * radius;
+
+		while (y >= x)
+		{
+			FillCirclePoints(image, center, x, y, color);
+			if (d <= 0)
+			{
+				d += 4 * x + 6;
+			}
+			else
+			{
+				d += 4 * (x - y) + 10;
+				--y;
+			}
+			++x;
+		}
+	}
+
+	//     : (x / scale, y / scale),   -  
+	struct SubpixelPoint
+	{
+		int64_t x;
+		int64_t y;
+	};
+
+	using Contour = std::vector<SubpixelPoint>;
+
+	//       1/256 
+	constexpr int64_t STROKE_SCALE = 256;
+
+	struct PolygonEdge
+	{
+		int yStart; //    ,    
+		int yEnd;
+		int64_t x0; //  
+		int64_t y0;
+		int64_t dx;
+		int64_t dy; // > 0
+		int winding; // +1   , -1 
+	};
+
+	//        64-  
+	constexpr int64_t MAX_POLYGON_COORD = int64_t{ 1 } << 29;
+
+	int64_t CeilDiv(int64_t value, int64_t divisor) noexcept
+	{
+		assert(divisor > 0);
+		return value >= 0 ? (value + divisor - 1) / divisor : -(-value / divisor);
+	}
+
+	//  ,          y:
+	// x + 0.5 >= (x0 + ((y + 0.5) * scale - y0) * dx / dy) / scale,     
+	int64_t GetFirstColumnRightOf(const PolygonEdge& edge, int y, int64_t scale) noexcept
+	{
+		return CeilDiv(2 * edge.dy * edge.x0 + ((2 * int64_t{ y } + 1) * scale - 2 * edge.y0) * edge.dx - scale * edge.dy,
+			2 * scale * edge.dy);
+	}
+
+	//         (y + 0.5),
+	//  ,    : [; ) .
+	//            .
+	//    ,     
+	template <typename Target>
+	void RasterizeContours(Target& img, const std::vector<Contour>& contours, int64_t scale, uint32_t color, FillRule rule)
+	{
+		const auto size = img.GetImageSize();
+
+		//  ,    
+		std::vector<PolygonEdge> edges;
+		for (const auto& contour : contours)
+		{
+			for (size_t i = 0; i < contour.size(); ++i)
+			{
+				SubpixelPoint from = contour[i];
+				SubpixelPoint to = contour[(i + 1) % contour.size()];
+				if (std::abs(from.x) >= MAX_POLYGON_COORD || std::abs(from.y) >= MAX_POLYGON_COORD)
+				{
+					throw std::out_of_range("Polygon vertex is too far from image");
+				}
+
+				const int winding = from.y < to.y ? 1 : -1;
+				if (from.y > to.y)
+				{
+					std::swap(from, to);
+				}
+
+				// ,     [from.y; to.y);     
+				const int64_t yStart = std::max<int64_t>(CeilDiv(2 * from.y - scale, 2 * scale), 0);
+				const int64_t yEnd = std::min<int64_t>(CeilDiv(2 * to.y - scale, 2 * scale), size.height) - 1;
+				if (yStart > yEnd) continue;
+
+				edges.push_back({ static_cast<int>(yStart), static_cast<int>(yEnd), from.x, from.y,
+					to.x - from.x, to.y - from.y, winding });
+			}
+		}
+		if (edges.empty()) return;
+
+		std::sort(edges.begin(), edges.end(), [](const PolygonEdge& lhs, const PolygonEdge& rhs) {
+			return lhs.yStart < rhs.yStart;
+		});
+
+		//  [left; right),  
+		auto fillBetween = [&img, color, width = int64_t{ size.width }](int y, int64_t left, int64_t right) {
+			left = std::clamp<int64_t>(left, 0, width);
+			right = std::clamp<int64_t>(right, 0, width);
+			if (left < right)
+			{
+				img.FillSpan(y, static_cast<int>(left), static_cast<int>(right - 1), color);
+			}
+		};
+
+		std::vector<const PolygonEdge*> active;
+		std::vector<std::pair<int64_t, int>> crossings;
+		size_t next = 0;
+		for (int y = edges.front().yStart; next < edges.size() || !active.empty(); ++y)
 		{
-			img.SetPixel({ xx, c.y + x }, color);
-			img.SetPixel({ xx, c.y - x }, color);
+			std::erase_if(active, [y](const PolygonEdge* edge) { return edge->yEnd < y; });
+			for (; next < edges.size() && edges[next].yStart == y; ++next)
+			{
+				active.push_back(&edges[next]);
+			}
+			if (active.empty())
+			{
+				//      
+				y = edges[next].yStart - 1;
+				continue;
+			}
+
+			crossings.clear();
+			for (const PolygonEdge* edge : active)
+			{
+				crossings.emplace_back(GetFirstColumnRightOf(*edge, y, scale), edge->winding);
+			}
+			std::sort(crossings.begin(), crossings.end());
+
+			if (rule == FillRule::EvenOdd)
+			{
+				for (size_t i = 0; i + 1 < crossings.size(); i += 2)
+				{
+					fillBetween(y, crossings[i].first, crossings[i + 1].first);
+				}
+				continue;
+			}
+
+			int winding = 0;
+			int64_t left = 0;
+			for (const auto& [x, direction] : crossings)
+			{
+				if (winding == 0)
+				{
+					left = x;
+				}
+				winding += direction;
+				if (winding == 0)
+				{
+					fillBetween(y, left, x);
+				}
+			}
+		}
+	}
+
+	template <typename Target>
+	void RasterizePolygon(Target& img, const std::vector<Point>& vertices, uint32_t color, FillRule rule)
+	{
+		Contour contour;
+		contour.reserve(vertices.size());
+		for (const auto& v : vertices)
+		{
+			contour.push_back({ v.x, v.y });
+		}
+		RasterizeContours(img, { contour }, 1, color, rule);
+	}
+
+	//  .  p  -   (p.x + 0.5, p.y + 0.5)
+	struct Vector2
+	{
+		double x;
+		double y;
+	};
+
+	SubpixelPoint ToSubpixel(Vector2 v)
+	{
+		return { std::llround(v.x * STROKE_SCALE), std::llround(v.y * STROKE_SCALE) };
+	}
+
+	Vector2 PixelCenter(Point p) noexcept
+	{
+		return { p.x + 0.5, p.y + 0.5 };
+	}
+
+	//     ,        1/4 
+	int GetArcSegments(double radius)
+	{
+		if (radius <= 0.25) return 8;
+		const double step = std::acos(1 - 0.25 / radius);
+		return std::max(8, static_cast<int>(std::ceil(std::numbers::pi / step)));
+	}
+
+	//   center   from   to (),  
+	void AddArc(Contour& contour, Vector2 center, double radius, double from, double to, int segments)
+	{
+		for (int i = 0; i <= segments; ++i)
+		{
+			const double angle = from + (to - from) * i / segments;
+			contour.push_back(ToSubpixel({ center.x + radius * std::cos(angle), center.y + radius * std::sin(angle) }));
+		}
+	}
+
+	Contour MakeCircleContour(Vector2 center, double radius)
+	{
+		Contour contour;
+		AddArc(contour, center, radius, 0, 2 * std::numbers::pi, GetArcSegments(radius));
+		contour.pop_back();
+		return contour;
+	}
+
+	template <typename Target>
+	void RasterizeThickLine(Target& img, Point from, Point to, int width, uint32_t color, LineCap cap)
+	{
+		if (width <= 0) return;
+
+		const Vector2 a = PixelCenter(from);
+		const Vector2 b = PixelCenter(to);
+		const double half = width / 2.0;
+		const double length = std::hypot(b.x - a.x, b.y - a.y);
+		//         x
+		const Vector2 dir = length > 0 ? Vector2{ (b.x - a.x) / length, (b.y - a.y) / length } : Vector2{ 1, 0 };
+		const Vector2 normal{ -dir.y * half, dir.x * half };
+
+		Contour contour;
+		if (cap == LineCap::Round)
+		{
+			//     
+			const double angle = std::atan2(dir.y, dir.x);
+			const int segments = std::max(4, GetArcSegments(half) / 2);
+			AddArc(contour, b, half, angle - std::numbers::pi / 2, angle + std::numbers::pi / 2, segments);
+			AddArc(contour, a, half, angle + std::numbers::pi / 2, angle + 3 * std::numbers::pi / 2, segments);
+		}
+		else
+		{
+			const double extension = cap == LineCap::Square ? half : 0;
+			const Vector2 start{ a.x - dir.x * extension, a.y - dir.y * extension };
+			const Vector2 end{ b.x + dir.x * extension, b.y + dir.y * extension };
+			contour = {
+				ToSubpixel({ start.x + normal.x, start.y + normal.y }),
+				ToSubpixel({ end.x + normal.x, end.y + normal.y }),
+				ToSubpixel({ end.x - normal.x, end.y - normal.y }),
+				ToSubpixel({ start.x - normal.x, start.y - normal.y }),
+			};
+		}
+		RasterizeContours(img, { contour }, STROKE_SCALE, color, FillRule::NonZero);
+	}
+
+	//    radius - width / 2  radius + width / 2
+	template <typename Target>
+	void RasterizeThickCircle(Target& img, Point center, int radius, int width, uint32_t color)
+	{
+		if (radius < 0 || width <= 0) return;
+
+		const Vector2 c = PixelCenter(center);
+		const double half = width / 2.0;
+		std::vector<Contour> contours{ MakeCircleContour(c, radius + half) };
+		if (radius > half)
+		{
+			contours.push_back(MakeCircleContour(c, radius - half));
+		}
+		RasterizeContours(img, contours, STROKE_SCALE, color, FillRule::EvenOdd);
+	}
+
+	//     coverage (0..1)   
+	template <typename Target>
+	void BlendCoverage(Target& img, Point p, uint32_t color, double coverage)
+	{
+		const auto alpha = static_cast<uint32_t>(std::lround(std::clamp(coverage, 0.0, 1.0) * 255));
+		img.BlendPixel(p, alpha << 24 | (color & 0xFFFFFF));
+	}
+
+	//  :         
+	//          
+	template <typename Target>
+	void RasterizeWuLine(Target& img, Point from, Point to, uint32_t color)
+	{
+		const bool steep = std::abs(to.y - from.y) > std::abs(to.x - from.x);
+		if (steep)
+		{
+			std::swap(from.x, from.y);
+			std::swap(to.x, to.y);
+		}
+		if (from.x > to.x)
+		{
+			std::swap(from, to);
+		}
+
+		const double gradient = from.x == to.x ? 0 : static_cast<double>(to.y - from.y) / (to.x - from.x);
+		auto plot = [&img, steep, color](int x, int y, double coverage) {
+			BlendCoverage(img, steep ? Point{ y, x } : Point{ x, y }, color, coverage);
+		};
+
+		for (int x = from.x; x <= to.x; ++x)
+		{
+			const double y = from.y + gradient * (x - from.x);
+			const double base = std::floor(y);
+			const double frac = y - base;
+			plot(x, static_cast<int>(base), 1 - frac);
+			plot(x, static_cast<int>(base) + 1, frac);
+		}
+	}
+
+	//   ,     
+	template <typename Target>
+	void BlendCirclePoints(Target& img, Point c, int x, int y, uint32_t color, double coverage)
+	{
+		for (int sx : { 1, -1 })
+		{
+			if (sx < 0 && x == 0) continue;
+			for (int sy : { 1, -1 })
+			{
+				if (sy < 0 && y == 0) continue;
+				BlendCoverage(img, { c.x + sx * x, c.y + sy * y }, color, coverage);
+				if (x != y)
+				{
+					BlendCoverage(img, { c.x + sy * y, c.y + sx * x }, color, coverage);
+				}
+			}
+		}
+	}
+
+	//  :   x <= y   x   y = sqrt(r^2 - x^2)
+	template <typename Target>
+	void RasterizeWuCircle(Target& img, Point center, int radius, uint32_t color)
+	{
+		if (radius < 0) return;
+
+		const double r2 = static_cast<double>(radius) * radius;
+		for (int x = 0;; ++x)
+		{
+			const double y = std::sqrt(std::max(r2 - static_cast<double>(x) * x, 0.0));
+			if (x > y) break;
+
+			const double base = std::floor(y);
+			const double frac = y - base;
+			BlendCirclePoints(img, center, x, static_cast<int>(base), color, 1 - frac);
+			BlendCirclePoints(img, center, x, static_cast<int>(base) + 1, color, frac);
 		}
 	}
 
@@ -134,51 +524,613 @@ namespace
 */
 // :    '-'    
 
-void DrawCircle(Image& img, Point center, int radius, uint32_t color)
+template <typename ImageT>
+void DrawLine(ImageT& img, Point from, Point to, uint32_t color)
 {
-	if (radius < 0) return;
-	
-	int x{};
-	int y = radius;
-	int d = 3 - 2 * radius; //  
+	RasterizeLine(img, from, to, color);
+}
+
+template <typename ImageT>
+void DrawCircle(ImageT& img, Point center, int radius, uint32_t color)
+{
+	RasterizeCircle(img, center, radius, color);
+}
+
+template <typename ImageT>
+void FillCircle(ImageT& image, Point center, int radius, uint32_t color)
+{
+	RasterizeFilledCircle(image, center, radius, color);
+}
+
+template <typename ImageT>
+void FillPolygon(ImageT& image, const std::vector<Point>& vertices, uint32_t color, FillRule rule)
+{
+	RasterizePolygon(image, vertices, color, rule);
+}
+
+template <typename ImageT>
+void FillTriangle(ImageT& image, Point a, Point b, Point c, uint32_t color)
+{
+	RasterizePolygon(image, { a, b, c }, color, FillRule::EvenOdd);
+}
+
+template <typename ImageT>
+void DrawLineAA(ImageT& image, Point from, Point to, uint32_t color)
+{
+	RasterizeWuLine(image, from, to, color);
+}
+
+template <typename ImageT>
+void DrawCircleAA(ImageT& image, Point center, int radius, uint32_t color)
+{
+	RasterizeWuCircle(image, center, radius, color);
+}
+
+template <typename ImageT>
+void DrawThickLine(ImageT& image, Point from, Point to, int width, uint32_t color, LineCap cap)
+{
+	RasterizeThickLine(image, from, to, width, color, cap);
+}
+
+template <typename ImageT>
+void DrawThickCircle(ImageT& image, Point center, int radius, int width, uint32_t color)
+{
+	RasterizeThickCircle(image, center, radius, width, color);
+}
 
-	// 4, 6, 10 -      x*x + y*y <= r*r
-	while (y >= x)
+namespace
+{
+	struct Span
+	{
+		int y;
+		int x0;
+		int x1;
+		uint32_t color;
+	};
+
+	//   ,   ,   
+	class SpanRecorder
 	{
-		DrawCirclePoints(img, center, x, y, color);
-		if (d <= 0)
+	public:
+		SpanRecorder(ImageSize size, std::vector<Span>& spans)
+			: m_size(size)
+			, m_spans(spans)
 		{
-			d += 4 * x + 6;
 		}
-		else
+
+		ImageSize GetImageSize() const noexcept
+		{
+			return m_size;
+		}
+
+		void SetPixel(Point p, uint32_t color)
+		{
+			FillSpan(p.y, p.x, p.x, color);
+		}
+
+		void FillSpan(int y, int x0, int x1, uint32_t color)
+		{
+			if (y < 0 || y >= m_size.height) return;
+
+			x0 = std::max(x0, 0);
+			x1 = std::min(x1, m_size.width - 1);
+			if (x0 <= x1)
+			{
+				m_spans.push_back({ y, x0, x1, color });
+			}
+		}
+
+	private:
+		ImageSize m_size;
+		std::vector<Span>& m_spans;
+	};
+
+	void RecordShape(const Shape& shape, SpanRecorder& recorder)
+	{
+		std::visit([&recorder](const auto& s) {
+			using T = std::decay_t<decltype(s)>;
+			if constexpr (std::is_same_v<T, LineShape>)
+			{
+				RasterizeLine(recorder, s.from, s.to, s.color);
+			}
+			else if constexpr (std::is_same_v<T, CircleShape>)
+			{
+				RasterizeCircle(recorder, s.center, s.radius, s.color);
+			}
+			else if constexpr (std::is_same_v<T, FilledCircleShape>)
+			{
+				RasterizeFilledCircle(recorder, s.center, s.radius, s.color);
+			}
+			else
+			{
+				RasterizePolygon(recorder, s.vertices, s.color, s.rule);
+			}
+		}, shape);
+	}
+
+} // namespace
+
+template <unsigned TileSize>
+void DrawBatch(BasicImage<TileSize>& image, const std::vector<Shape>& shapes, ThreadPool& pool)
+{
+	const auto imageSize = image.GetImageSize();
+	const auto grid = image.GetTileGridSize();
+	const int size = static_cast<int>(TileSize);
+
+	// 1.     
+	std::vector<std::vector<Span>> shapeSpans(shapes.size());
+	pool.ParallelFor(shapes.size(), [&](size_t i) {
+		SpanRecorder recorder{ imageSize, shapeSpans[i] };
+		RecordShape(shapes[i], recorder);
+	});
+
+	// 2.       , 
+	//     
+	std::vector<std::vector<Span>> bins(static_cast<size_t>(grid.width) * static_cast<size_t>(grid.height));
+	for (const auto& spans : shapeSpans)
+	{
+		for (const auto& span : spans)
 		{
-			d += 4 * (x - y) + 10;
-			--y;
+			const int tileY = span.y / size;
+			for (int tileX = span.x0 / size; tileX <= span.x1 / size; ++tileX)
+			{
+				bins[static_cast<size_t>(tileY) * static_cast<size_t>(grid.width) + static_cast<size_t>(tileX)].push_back({
+					span.y - tileY * size,
+					std::max(span.x0, tileX * size) - tileX * size,
+					std::min(span.x1, tileX * size + size - 1) - tileX * size,
+					span.color });
+			}
 		}
-		++x;
 	}
+
+	// 3.       ,   
+	std::vector<std::pair<BasicTile<TileSize>*, const std::vector<Span>*>> work;
+	for (size_t index = 0; index < bins.size(); ++index)
+	{
+		if (bins[index].empty()) continue;
+
+		const int tileX = static_cast<int>(index % static_cast<size_t>(grid.width));
+		const int tileY = static_cast<int>(index / static_cast<size_t>(grid.width));
+		work.emplace_back(&image.UnshareTile(tileX, tileY), &bins[index]);
+	}
+
+	pool.ParallelFor(work.size(), [&work](size_t i) {
+		auto& [tile, spans] = work[i];
+		for (const auto& span : *spans)
+		{
+			tile->FillRect({ span.x0, span.y }, static_cast<unsigned>(span.x1 - span.x0 + 1), 1, span.color);
+		}
+	});
 }
 
-void FillCircle(Image& image, Point center, int radius, uint32_t color)
+template <unsigned TileSize>
+void DrawBatch(BasicImage<TileSize>& image, const std::vector<Shape>& shapes)
 {
-	if (radius < 0) return;
+	DrawBatch(image, shapes, GetDefaultThreadPool());
+}
 
-	int x{};
-	int y = radius;
-	int d = 3 - 2 * radius;
+namespace
+{
+	//        tolerance
+	bool IsSimilarColor(uint32_t lhs, uint32_t rhs, unsigned tolerance) noexcept
+	{
+		for (int shift = 0; shift < 32; shift += 8)
+		{
+			const int a = static_cast<int>(lhs >> shift & 0xFF);
+			const int b = static_cast<int>(rhs >> shift & 0xFF);
+			if (static_cast<unsigned>(std::abs(a - b)) > tolerance) return false;
+		}
+		return true;
+	}
 
-	while (y >= x)
+	//     :     ,
+	//       .   
+	//  ,     
+	template <unsigned TileSize>
+	class FloodRegion
 	{
-		FillCirclePoints(image, center, x, y, color);
-		if (d <= 0)
+	public:
+		using Tile = BasicTile<TileSize>;
+
+		struct Run
+		{
+			int y;
+			int x0;
+			int x1;
+		};
+
+		FloodRegion(const BasicImage<TileSize>& image, uint32_t seedColor, unsigned tolerance)
+			: m_image(image)
+			, m_size(image.GetImageSize())
+			, m_tilesX(image.GetTileGridSize().width)
+			, m_seedColor(seedColor)
+			, m_tolerance(tolerance)
+			, m_tiles(image.GetTileCount(), nullptr)
+			, m_visited(image.GetTileCount())
+			, m_claimed(image.GetTileCount(), 0)
+			, m_whole(image.GetTileCount(), false)
 		{
-			d += 4 * x + 6;
 		}
-		else
+
+		void Grow(Point seed)
+		{
+			m_seeds.push_back({ seed.y, seed.x, seed.x });
+			while (!m_seeds.empty())
+			{
+				const Run seedRun = m_seeds.back();
+				m_seeds.pop_back();
+				Scan(seedRun);
+			}
+		}
+
+		// ,   ( ,  )
+		const std::vector<Run>& GetRuns() const noexcept
+		{
+			return m_runs;
+		}
+
+		//    :      
+		bool IsWholeTile(size_t index) const noexcept
+		{
+			const int tileX = static_cast<int>(index % static_cast<size_t>(m_tilesX));
+			const int tileY = static_cast<int>(index / static_cast<size_t>(m_tilesX));
+			const int width = std::min(static_cast<int>(TileSize), m_size.width - tileX * static_cast<int>(TileSize));
+			const int height = std::min(static_cast<int>(TileSize), m_size.height - tileY * static_cast<int>(TileSize));
+			return m_whole[index] || m_claimed[index] == static_cast<size_t>(width * height);
+		}
+
+	private:
+		static constexpr size_t BITS = 64;
+		static constexpr size_t WORDS = (TileSize * TileSize + BITS - 1) / BITS;
+
+		size_t GetTileIndex(int x, int y) const noexcept
+		{
+			return static_cast<size_t>(y / static_cast<int>(TileSize)) * static_cast<size_t>(m_tilesX)
+				+ static_cast<size_t>(x / static_cast<int>(TileSize));
+		}
+
+		const Tile& GetTile(size_t index)
 		{
-			d += 4 * (x - y) + 10;
-			--y;
+			if (!m_tiles[index])
+			{
+				m_tiles[index] = &*m_image.GetTile(index);
+			}
+			return *m_tiles[index];
+		}
+
+		//   seed.y   [seed.x0; seed.x1]:  
+		//      ,     
+		void Scan(Run seed)
+		{
+			if (seed.y < 0 || seed.y >= m_size.height) return;
+
+			const int last = std::min(seed.x1, m_size.width - 1);
+			int x = std::max(seed.x0, 0);
+			while ((x = FindClaimable(x, seed.y, last)) <= last)
+			{
+				const int right = x + ClaimRun(x, seed.y, m_size.width - 1, 1) - 1;
+				const int left = x - ClaimRun(x - 1, seed.y, 0, -1);
+				m_runs.push_back({ seed.y, left, right });
+				m_seeds.push_back({ seed.y - 1, left, right });
+				m_seeds.push_back({ seed.y + 1, left, right });
+				//  right + 1  
+				x = right + 2;
+			}
+		}
+
+		//         y  [x; end]  end + 1.
+		//       
+		int FindClaimable(int x, int y, int end)
+		{
+			const int size = static_cast<int>(TileSize);
+			const size_t rowStart = static_cast<size_t>(y % size) * TileSize;
+			while (x <= end)
+			{
+				const size_t index = GetTileIndex(x, y);
+				const int tileX = x - x % size;
+				const int stop = std::min(end, tileX + size - 1);
+				if (!m_whole[index])
+				{
+					const Tile& tile = GetTile(index);
+					if (tile.IsSolid())
+					{
+						if (IsSimilarColor(tile.GetPixel({ 0, 0 }), m_seedColor, m_tolerance))
+						{
+							ClaimWholeTile(index);
+						}
+					}
+					else
+					{
+						const uint32_t* row = tile.GetData() + rowStart;
+						const auto& visited = m_visited[index];
+						for (; x <= stop; ++x)
+						{
+							const size_t bit = rowStart + static_cast<size_t>(x - tileX);
+							const bool taken = !visited.empty() && (visited[bit / BITS] >> (bit % BITS) & 1);
+							if (!taken && IsSimilarColor(row[x - tileX], m_seedColor, m_tolerance)) return x;
+						}
+					}
+				}
+				x = stop + 1;
+			}
+			return x;
+		}
+
+		//         y   x
+		//   step (1  -1),   end;   .
+		//          .
+		//     ,    
+		int ClaimRun(int x, int y, int end, int step)
+		{
+			const int size = static_cast<int>(TileSize);
+			const size_t rowStart = static_cast<size_t>(y % size) * TileSize;
+			int claimed = 0;
+			while ((end - x) * step >= 0)
+			{
+				const size_t index = GetTileIndex(x, y);
+				if (m_whole[index]) break;
+
+				const Tile& tile = GetTile(index);
+				if (tile.IsSolid())
+				{
+					if (IsSimilarColor(tile.GetPixel({ 0, 0 }), m_seedColor, m_tolerance))
+					{
+						ClaimWholeTile(index);
+					}
+					break;
+				}
+
+				auto& visited = m_visited[index];
+				if (visited.empty())
+				{
+					visited.resize(WORDS);
+				}
+				const int tileX = x - x % size;
+				const int stop = step > 0 ? std::min(end, tileX + size - 1) : std::max(end, tileX);
+				const uint32_t* row = tile.GetData() + rowStart;
+				for (; (stop - x) * step >= 0; x += step)
+				{
+					const size_t bit = rowStart + static_cast<size_t>(x - tileX);
+					uint64_t& word = visited[bit / BITS];
+					const uint64_t mask = uint64_t{ 1 } << (bit % BITS);
+					if ((word & mask) || !IsSimilarColor(row[x - tileX], m_seedColor, m_tolerance)) return claimed;
+
+					word |= mask;
+					++m_claimed[index];
+					++claimed;
+				}
+			}
+			return claimed;
+		}
+
+		//         
+		void ClaimWholeTile(size_t index)
+		{
+			m_whole[index] = true;
+
+			const int size = static_cast<int>(TileSize);
+			const int x0 = static_cast<int>(index % static_cast<size_t>(m_tilesX)) * size;
+			const int y0 = static_cast<int>(index / static_cast<size_t>(m_tilesX)) * size;
+			const int x1 = std::min(x0 + size, m_size.width) - 1;
+			const int y1 = std::min(y0 + size, m_size.height) - 1;
+
+			m_seeds.push_back({ y0 - 1, x0, x1 });
+			m_seeds.push_back({ y1 + 1, x0, x1 });
+			PushColumnSeeds(x0 - 1, y0, y1);
+			PushColumnSeeds(x1 + 1, y0, y1);
+		}
+
+		//  x    :     
+		//  ,       
+		void PushColumnSeeds(int x, int y0, int y1)
+		{
+			if (x < 0 || x >= m_size.width) return;
+
+			const size_t index = GetTileIndex(x, y0);
+			if (m_whole[index]) return;
+
+			const Tile& tile = GetTile(index);
+			if (tile.IsSolid())
+			{
+				if (IsSimilarColor(tile.GetPixel({ 0, 0 }), m_seedColor, m_tolerance))
+				{
+					m_seeds.push_back({ y0, x, x });
+				}
+				return;
+			}
+
+			for (int y = y0; y <= y1; ++y)
+			{
+				m_seeds.push_back({ y, x, x });
+			}
+		}
+
+		const BasicImage<TileSize>& m_image;
+		ImageSize m_size;
+		int m_tilesX;
+		uint32_t m_seedColor;
+		unsigned m_tolerance;
+		std::vector<const Tile*> m_tiles;
+		//  ,       
+		std::vector<std::vector<uint64_t>> m_visited;
+		std::vector<size_t> m_claimed;
+		std::vector<bool> m_whole;
+		std::vector<Run> m_seeds;
+		std::vector<Run> m_runs;
+	};
+
+} // namespace
+
+template <unsigned TileSize>
+void FloodFill(BasicImage<TileSize>& image, Point seed, uint32_t color, unsigned tolerance)
+{
+	if (!IsPointInImage(seed, image.GetImageSize())) return;
+
+	const uint32_t seedColor = image.GetPixel(seed);
+	//        
+	if (tolerance == 0 && seedColor == color) return;
+
+	FloodRegion<TileSize> region{ image, seedColor, tolerance };
+	region.Grow(seed);
+
+	//    ,       ,
+	//  ,    ,    
+	const CoW<BasicTile<TileSize>> solid{ color };
+	const auto grid = image.GetTileGridSize();
+	const int size = static_cast<int>(TileSize);
+	std::vector<std::vector<typename FloodRegion<TileSize>::Run>> bins(image.GetTileCount());
+	for (const auto& run : region.GetRuns())
+	{
+		const int tileY = run.y / size;
+		for (int tileX = run.x0 / size; tileX <= run.x1 / size; ++tileX)
+		{
+			bins[static_cast<size_t>(tileY) * static_cast<size_t>(grid.width) + static_cast<size_t>(tileX)].push_back({
+				run.y - tileY * size,
+				std::max(run.x0, tileX * size) - tileX * size,
+				std::min(run.x1, tileX * size + size - 1) - tileX * size });
+		}
+	}
+
+	for (size_t index = 0; index < bins.size(); ++index)
+	{
+		if (region.IsWholeTile(index))
+		{
+			image.SetTile(index, solid);
+			continue;
+		}
+		if (bins[index].empty()) continue;
+
+		auto& tile = image.UnshareTile(static_cast<int>(index % static_cast<size_t>(grid.width)),
+			static_cast<int>(index / static_cast<size_t>(grid.width)));
+		for (const auto& run : bins[index])
+		{
+			tile.FillRect({ run.x0, run.y }, static_cast<unsigned>(run.x1 - run.x0 + 1), 1, color);
 		}
-		++x;
 	}
-}
\ No newline at end of file
+}
+
+namespace
+{
+	//      64 ;   , 
+	//  ,       
+	class SparseVisited
+	{
+	public:
+		explicit SparseVisited(int width)
+			: m_wordsPerRow(static_cast<uint64_t>(width) / 64 + 1)
+		{
+		}
+
+		bool Contains(Point p) const
+		{
+			const auto it = m_words.find(GetKey(p));
+			return it != m_words.end() && (it->second >> (p.x % 64) & 1);
+		}
+
+		void Insert(Point p)
+		{
+			m_words[GetKey(p)] |= uint64_t{ 1 } << (p.x % 64);
+		}
+
+	private:
+		uint64_t GetKey(Point p) const noexcept
+		{
+			return static_cast<uint64_t>(p.y) * m_wordsPerRow + static_cast<uint64_t>(p.x / 64);
+		}
+
+		uint64_t m_wordsPerRow;
+		std::unordered_map<uint64_t, uint64_t> m_words;
+	};
+} // namespace
+
+//     ,    
+//      GetPixel  FillSpan
+template <unsigned TileSize>
+void FloodFill(BasicPagedImage<TileSize>& image, Point seed, uint32_t color, unsigned tolerance)
+{
+	const auto size = image.GetImageSize();
+	if (!IsPointInImage(seed, size)) return;
+
+	const uint32_t seedColor = image.GetPixel(seed);
+	if (tolerance == 0 && seedColor == color) return;
+
+	//       , 
+	//    
+	SparseVisited visited{ size.width };
+	const auto matches = [&](Point p) {
+		return !visited.Contains(p) && IsSimilarColor(image.GetPixel(p), seedColor, tolerance);
+	};
+
+	std::vector<Point> seeds{ seed };
+	while (!seeds.empty())
+	{
+		const Point p = seeds.back();
+		seeds.pop_back();
+		if (!matches(p)) continue;
+
+		int left = p.x;
+		while (left > 0 && matches({ left - 1, p.y }))
+		{
+			--left;
+		}
+		int right = p.x;
+		while (right + 1 < size.width && matches({ right + 1, p.y }))
+		{
+			++right;
+		}
+		for (int x = left; x <= right; ++x)
+		{
+			visited.Insert({ x, p.y });
+		}
+		image.FillSpan(p.y, left, right, color);
+
+		//          
+		for (const int y : { p.y - 1, p.y + 1 })
+		{
+			if (y < 0 || y >= size.height) continue;
+
+			bool inRun = false;
+			for (int x = left; x <= right; ++x)
+			{
+				const bool match = matches({ x, y });
+				if (match && !inRun)
+				{
+					seeds.push_back({ x, y });
+				}
+				inRun = match;
+			}
+		}
+	}
+}
+
+#define LAB9_INSTANTIATE_DRAWER(IMAGE) \
+	template void DrawLine(IMAGE&, Point, Point, uint32_t); \
+	template void DrawCircle(IMAGE&, Point, int, uint32_t); \
+	template void FillCircle(IMAGE&, Point, int, uint32_t); \
+	template void FillPolygon(IMAGE&, const std::vector<Point>&, uint32_t, FillRule); \
+	template void FillTriangle(IMAGE&, Point, Point, Point, uint32_t); \
+	template void DrawLineAA(IMAGE&, Point, Point, uint32_t); \
+	template void DrawCircleAA(IMAGE&, Point, int, uint32_t); \
+	template void DrawThickLine(IMAGE&, Point, Point, int, uint32_t, LineCap); \
+	template void DrawThickCircle(IMAGE&, Point, int, int, uint32_t); \
+	template void FloodFill(IMAGE&, Point, uint32_t, unsigned);
+
+#define LAB9_INSTANTIATE_BATCH(TILE_SIZE) \
+	template void DrawBatch(BasicImage<TILE_SIZE>&, const std::vector<Shape>&, ThreadPool&); \
+	template void DrawBatch(BasicImage<TILE_SIZE>&, const std::vector<Shape>&);
+
+LAB9_INSTANTIATE_DRAWER(BasicImage<8>)
+LAB9_INSTANTIATE_DRAWER(BasicImage<16>)
+LAB9_INSTANTIATE_DRAWER(BasicImage<32>)
+LAB9_INSTANTIATE_DRAWER(BasicImage<64>)
+LAB9_INSTANTIATE_DRAWER(BasicPagedImage<8>)
+LAB9_INSTANTIATE_DRAWER(BasicPagedImage<16>)
+LAB9_INSTANTIATE_DRAWER(BasicPagedImage<32>)
+LAB9_INSTANTIATE_DRAWER(BasicPagedImage<64>)
+LAB9_INSTANTIATE_BATCH(8)
+LAB9_INSTANTIATE_BATCH(16)
+LAB9_INSTANTIATE_BATCH(32)
+LAB9_INSTANTIATE_BATCH(64)
+
+#undef LAB9_INSTANTIATE_DRAWER
+#undef LAB9_INSTANTIATE_BATCH
\ No newline at end of file
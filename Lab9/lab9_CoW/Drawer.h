@@ -1,6 +1,10 @@
 #pragma once
 
 #include "Image.h"
+#include "ThreadPool.h"
+
+#include <variant>
+#include <vector>
 
 /*
     
@@ -8,6 +12,95 @@
 https://ru.wikipedia.org/wiki/_
 */
 
-void DrawLine(Image& image, Point from, Point to, uint32_t color);
-void DrawCircle(Image& image, Point center, int radius, uint32_t color);
-void FillCircle(Image& image, Point center, int radius, uint32_t color);
\ No newline at end of file
+template <unsigned TileSize>
+class BasicPagedImage;
+
+//    Drawer.cpp     8, 16, 32  64:
+// ImageT - BasicImage  BasicPagedImage
+template <typename ImageT>
+void DrawLine(ImageT& image, Point from, Point to, uint32_t color);
+template <typename ImageT>
+void DrawCircle(ImageT& image, Point center, int radius, uint32_t color);
+template <typename ImageT>
+void FillCircle(ImageT& image, Point center, int radius, uint32_t color);
+
+// ,           
+enum class FillRule
+{
+	EvenOdd, //  ,         
+	NonZero, //  ,       
+};
+
+//  ,      (
+//  );      
+template <typename ImageT>
+void FillPolygon(ImageT& image, const std::vector<Point>& vertices, uint32_t color,
+	FillRule rule = FillRule::EvenOdd);
+template <typename ImageT>
+void FillTriangle(ImageT& image, Point a, Point b, Point c, uint32_t color);
+
+//     ( ):    
+//    , - color  
+template <typename ImageT>
+void DrawLineAA(ImageT& image, Point from, Point to, uint32_t color);
+template <typename ImageT>
+void DrawCircleAA(ImageT& image, Point center, int radius, uint32_t color);
+
+enum class LineCap
+{
+	Butt,   //     
+	Square, //    
+	Round,  //  
+};
+
+//     width ,   
+template <typename ImageT>
+void DrawThickLine(ImageT& image, Point from, Point to, int width, uint32_t color,
+	LineCap cap = LineCap::Butt);
+template <typename ImageT>
+void DrawThickCircle(ImageT& image, Point center, int radius, int width, uint32_t color);
+
+//   (  )   seed: ,  
+//     seed     tolerance,   color
+template <unsigned TileSize>
+void FloodFill(BasicImage<TileSize>& image, Point seed, uint32_t color, unsigned tolerance = 0);
+template <unsigned TileSize>
+void FloodFill(BasicPagedImage<TileSize>& image, Point seed, uint32_t color, unsigned tolerance = 0);
+
+struct LineShape
+{
+	Point from;
+	Point to;
+	uint32_t color;
+};
+
+struct CircleShape
+{
+	Point center;
+	int radius;
+	uint32_t color;
+};
+
+struct FilledCircleShape
+{
+	Point center;
+	int radius;
+	uint32_t color;
+};
+
+struct PolygonShape
+{
+	std::vector<Point> vertices;
+	uint32_t color;
+	FillRule rule = FillRule::EvenOdd;
+};
+
+using Shape = std::variant<LineShape, CircleShape, FilledCircleShape, PolygonShape>;
+
+//    ,      ;
+//      DrawLine/DrawCircle/FillCircle/FillPolygon
+template <unsigned TileSize>
+void DrawBatch(BasicImage<TileSize>& image, const std::vector<Shape>& shapes, ThreadPool& pool);
+//    GetDefaultThreadPool()
+template <unsigned TileSize>
+void DrawBatch(BasicImage<TileSize>& image, const std::vector<Shape>& shapes);
\ No newline at end of file
@@ -1,15 +1,80 @@
 #pragma once
 
 #include "CoW.h"
+#include "PixelKernels.h"
 #include "Point.h"
 #include "Tile.h"
+#include "TileInterner.h"
+#include "TileSource.h"
 
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <optional>
 #include <sstream>
+#include <stdexcept>
+#include <unordered_set>
+#include <utility>
 
-class Image
+//     : size.height   size.width ,
+//  y   data + y * stride.     
+// stride = 0:   -       
+template <typename Pixel>
+struct TilePixels
+{
+	Point origin; //      
+	ImageSize size; //        TileSize
+	Pixel* data;
+	size_t stride;
+
+	Pixel* GetRow(int y) const noexcept
+	{
+		return data + static_cast<size_t>(y) * stride;
+	}
+};
+
+//     BuildPyramid
+enum class PyramidFilter
+{
+	Box,      //    2 x 2
+	Bilinear, //  1 3 3 1   ,    
+};
+
+//       :  ,
+//        
+//     :       ,
+//     CoWCounters  TileInterner::Intern
+struct TileSharingStats
+{
+	//      : sharedTiles + uniqueTiles
+	size_t distinctTiles = 0;
+	//      (, , ),    
+	size_t sharedTiles = 0;
+	size_t uniqueTiles = 0;
+	size_t solidTiles = 0;
+	//     GetByteSize
+	size_t sharedBytes = 0;
+	size_t uniqueBytes = 0;
+	//         ResetCoWStats(),
+	//   CoWCounters
+	CoWStats copies;
+};
+
+template <unsigned TileSize>
+class BasicImageView;
+
+//      TileSize .   
+//    ,  -    
+template <unsigned TileSize>
+class BasicImage
 {
 public:
-	explicit Image(ImageSize sz, uint32_t color = 0)
+	using Tile = BasicTile<TileSize>;
+	using TileSource = IBasicTileSource<TileSize>;
+	using TileCache = BasicTileCache<TileSize>;
+	using TileInterner = BasicTileInterner<TileSize>;
+
+	explicit BasicImage(ImageSize sz, uint32_t color = 0)
 		: m_imageSize(sz)
 	{
 		if (sz.width <= 0 || sz.height <= 0)
@@ -19,9 +84,23 @@ public:
 
 		m_tilesX = (sz.width + Tile::SIZE - 1) / Tile::SIZE;
 		m_tilesY = (sz.height + Tile::SIZE - 1) / Tile::SIZE;
-		const int tiles = m_tilesX * m_tilesY;
+		//       size_t:   
+		//     int
+		const size_t tiles = static_cast<size_t>(m_tilesX) * static_cast<size_t>(m_tilesY);
 		CoW<Tile> commonTile{ color };
-		m_tiles.assign(static_cast<size_t>(tiles), commonTile);
+		m_tiles.assign(tiles, commonTile);
+		m_dirty.assign(tiles, false);
+		m_tileVersions.assign(tiles, 0);
+	}
+
+	//    :      
+	//     ,     source. 
+	//        
+	explicit BasicImage(std::shared_ptr<const TileSource> source)
+		: BasicImage(source ? source->GetImageSize() : ImageSize{})
+	{
+		m_source = std::make_shared<TileCache>(std::move(source));
+		m_materialized.assign(m_tiles.size(), false);
 	}
 
 	ImageSize GetImageSize() const noexcept
@@ -29,16 +108,162 @@ public:
 		return m_imageSize;
 	}
 
+	//      
+	ImageSize GetTileGridSize() const noexcept
+	{
+		return { m_tilesX, m_tilesY };
+	}
+
+	size_t GetTileCount() const noexcept
+	{
+		return m_tiles.size();
+	}
+
+	//    tileY *   + tileX
+	const CoW<Tile>& GetTile(size_t index) const
+	{
+		CheckTileIndex(index);
+		return TileAt(index);
+	}
+
+	void SetTile(size_t index, CoW<Tile> tile)
+	{
+		CheckTileIndex(index);
+		AssignTile(index, std::move(tile));
+	}
+
+	// ,     ,    .
+	//        
+	TileSharingStats GetSharingStats() const
+	{
+		TileSharingStats stats;
+		std::unordered_set<const Tile*> distinct;
+		for (const auto& tile : m_tiles)
+		{
+			if (!distinct.insert(&*tile).second) continue;
+
+			const bool shared = tile.GetInstanceCount() > 1;
+			++(shared ? stats.sharedTiles : stats.uniqueTiles);
+			(shared ? stats.sharedBytes : stats.uniqueBytes) += tile->GetByteSize();
+			stats.solidTiles += tile->IsSolid();
+		}
+		stats.distinctTiles = distinct.size();
+		stats.copies = m_cowStats;
+		return stats;
+	}
+
+	void ResetCoWStats() noexcept
+	{
+		m_cowStats = {};
+	}
+
+	//             path
+	bool IsBackedBy(const std::string& path) const
+	{
+		const auto* source = GetTileSource();
+		return source && source->IsBackedBy(path);
+	}
+
+	//     , nullptr -     
+	const TileSource* GetTileSource() const noexcept
+	{
+		return m_source ? m_source->GetSource() : nullptr;
+	}
+
+	//  indices        ,
+	//     :      
+	void PinSourceTiles(const std::vector<size_t>& indices) const
+	{
+		if (!m_source) return;
+
+		for (size_t index : indices)
+		{
+			CheckTileIndex(index);
+			m_source->Pin(index);
+		}
+	}
+
+	//     path:     ,
+	//         ,  
+	// 
+	void ReleaseFile(const std::string& path) const
+	{
+		if (IsBackedBy(path))
+		{
+			m_source->Detach();
+		}
+	}
+
+	//  ,     other (   )
+	std::vector<size_t> GetChangedTiles(const BasicImage& other) const
+	{
+		if (other.m_imageSize.width != m_imageSize.width || other.m_imageSize.height != m_imageSize.height)
+		{
+			throw std::invalid_argument("Images must have the same size");
+		}
+
+		std::vector<size_t> changed;
+		for (size_t index = 0; index < m_tiles.size(); ++index)
+		{
+			// ,        ,  
+			if (m_source && m_source == other.m_source && !m_materialized[index] && !other.m_materialized[index]) continue;
+			if (!TileAt(index).IsSharedWith(other.TileAt(index)))
+			{
+				changed.push_back(index);
+			}
+		}
+		return changed;
+	}
+
+	//  :      
+	// ClearDirtyTiles(),     
+	bool IsTileDirty(size_t index) const
+	{
+		CheckTileIndex(index);
+		return m_dirty[index];
+	}
+
+	std::vector<size_t> GetDirtyTiles() const
+	{
+		std::vector<size_t> dirty;
+		for (size_t index = 0; index < m_dirty.size(); ++index)
+		{
+			if (m_dirty[index])
+			{
+				dirty.push_back(index);
+			}
+		}
+		return dirty;
+	}
+
+	void ClearDirtyTiles()
+	{
+		m_dirty.assign(m_dirty.size(), false);
+	}
+
+	//         .  , 
+	//       ;   
+	//    
+	Tile& UnshareTile(int tileX, int tileY)
+	{
+		if (!IsPointInImage({ tileX, tileY }, GetTileGridSize()))
+		{
+			throw std::out_of_range("Tile is out of image");
+		}
+
+		return *WritableTile(GetTileIndex(tileX, tileY)).Write().operator->();
+	}
+
 	uint32_t GetPixel(Point p) const
 	{
 		if (!IsPointInImage(p, m_imageSize)) return 0;
 
 		int tileX = p.x / Tile::SIZE;
 		int tileY = p.y / Tile::SIZE;
-		int index = tileY * m_tilesX + tileX;
+		const size_t index = GetTileIndex(tileX, tileY);
 		Point local{ p.x % Tile::SIZE, p.y % Tile::SIZE };
 
-		return m_tiles[static_cast<size_t>(index)]->GetPixel(local);
+		return TileAt(index)->GetPixel(local);
 	}
 
 	void SetPixel(Point p, uint32_t color)
@@ -48,21 +273,835 @@ public:
 		//    SetPixel(), 
 		int tileX = p.x / Tile::SIZE; //    p.y / Tile::SIZE   
 		int tileY = p.y / Tile::SIZE;
-		int index = tileY * m_tilesX + tileX;
+		const size_t index = GetTileIndex(tileX, tileY);
+		Point local{ p.x % Tile::SIZE, p.y % Tile::SIZE };
+
+		WritableTile(index)--->SetPixel(local, color);
+	}
+
+	//  color    - color (source-over);
+	//      
+	void BlendPixel(Point p, uint32_t color)
+	{
+		const uint32_t alpha = color >> 24;
+		if (alpha == 0 || !IsPointInImage(p, m_imageSize)) return;
+
+		const size_t index = GetTileIndex(p.x / Tile::SIZE, p.y / Tile::SIZE);
 		Point local{ p.x % Tile::SIZE, p.y % Tile::SIZE };
 
-		m_tiles[static_cast<size_t>(index)]--->SetPixel(local, color);
+		auto& tile = WritableTile(index);
+		const uint32_t blended = alpha == 0xFF ? color : ::BlendPixel(tile->GetPixel(local), color);
+		tile--->SetPixel(local, blended);
+	}
+
+	//   :     ,
+	//      
+	void ReadRow(int y, uint32_t* dst) const
+	{
+		if (y < 0 || y >= m_imageSize.height)
+		{
+			throw std::out_of_range("Row is out of image");
+		}
+
+		const int tileY = y / static_cast<int>(Tile::SIZE);
+		const int localY = y % static_cast<int>(Tile::SIZE);
+		for (int tileX = 0; tileX < m_tilesX; ++tileX)
+		{
+			const int x = tileX * static_cast<int>(Tile::SIZE);
+			const unsigned count = std::min(Tile::SIZE, static_cast<unsigned>(m_imageSize.width - x));
+			TileAt(GetTileIndex(tileX, tileY))->ReadRow({ 0, localY }, count, dst + x);
+		}
+	}
+
+	void WriteRow(int y, const uint32_t* src)
+	{
+		if (y < 0 || y >= m_imageSize.height)
+		{
+			throw std::out_of_range("Row is out of image");
+		}
+
+		const int tileY = y / static_cast<int>(Tile::SIZE);
+		const int localY = y % static_cast<int>(Tile::SIZE);
+		for (int tileX = 0; tileX < m_tilesX; ++tileX)
+		{
+			const int x = tileX * static_cast<int>(Tile::SIZE);
+			const unsigned count = std::min(Tile::SIZE, static_cast<unsigned>(m_imageSize.width - x));
+			WritableTile(GetTileIndex(tileX, tileY))--->WriteRow({ 0, localY }, count, src + x);
+		}
+	}
+
+	//   [x0; x1]  y,  
+	void FillSpan(int y, int x0, int x1, uint32_t color)
+	{
+		FillRect({ x0, y }, { x1, y }, color);
+	}
+
+	//   :   - 1 x 1
+	unsigned GetPyramidDepth() const noexcept
+	{
+		unsigned depth = 0;
+		for (ImageSize size = m_imageSize; size.width > 1 || size.height > 1; size = GetHalfSize(size))
+		{
+			++depth;
+		}
+		return depth;
+	}
+
+	//  level     ( 0 -  ).
+	//          ;
+	//      ,   
+	// ,   .     UnshareTile,
+	//    ,   
+	const BasicImage& GetPyramidLevel(unsigned level, PyramidFilter filter = PyramidFilter::Box) const
+	{
+		if (level > GetPyramidDepth())
+		{
+			throw std::out_of_range("Pyramid level is out of range");
+		}
+		if (level == 0) return *this;
+
+		UpdatePyramid(level, filter);
+		return m_pyramid[level - 1];
+	}
+
+	//   : [0] -   ,  - 1 x 1
+	const std::vector<BasicImage>& BuildPyramid(PyramidFilter filter = PyramidFilter::Box) const
+	{
+		UpdatePyramid(GetPyramidDepth(), filter);
+		return m_pyramid;
+	}
+
+	//     : func(TilePixels<const uint32_t>).
+	//     ,      
+	template <typename Func>
+	void ForEachTile(Func&& func) const
+	{
+		std::array<uint32_t, TileSize> solidRow{};
+		for (size_t index = 0; index < m_tiles.size(); ++index)
+		{
+			func(ReadTilePixels(index, solidRow.data()));
+		}
+	}
+
+	//  : func(TilePixels<uint32_t>),   
+	//        .   
+	//  ,   std::as_const(img)
+	template <typename Func>
+	void ForEachTile(Func&& func)
+	{
+		for (size_t index = 0; index < m_tiles.size(); ++index)
+		{
+			func(WriteTilePixels(index));
+		}
+	}
+
+	//    :       
+	// , func(Point  , const uint32_t* , size_t )
+	template <typename Func>
+	void ForEachRow(Func&& func) const
+	{
+		ForEachRow(Rect{ { 0, 0 }, m_imageSize }, func);
+	}
+
+	//     rect,      
+	template <typename Func>
+	void ForEachRow(Rect rect, Func&& func) const
+	{
+		CheckRect(rect);
+
+		const int size = static_cast<int>(TileSize);
+		const int firstX = rect.origin.x / size;
+		const int lastX = (rect.origin.x + rect.size.width - 1) / size;
+		std::vector<TilePixels<const uint32_t>> row(static_cast<size_t>(lastX - firstX + 1));
+		std::vector<uint32_t> solidRows(row.size() * TileSize);
+		for (int tileY = rect.origin.y / size; tileY <= (rect.origin.y + rect.size.height - 1) / size; ++tileY)
+		{
+			for (int tileX = firstX; tileX <= lastX; ++tileX)
+			{
+				const auto slot = static_cast<size_t>(tileX - firstX);
+				row[slot] = ClipTilePixels(ReadTilePixels(GetTileIndex(tileX, tileY),
+					solidRows.data() + slot * TileSize), rect);
+			}
+			VisitRows(row, func);
+		}
+	}
+
+	//    , ,   
+	BasicImageView<TileSize> View(Rect rect) const
+	{
+		return { *this, rect };
+	}
+
+	//     rect.   rect    ,
+	//   ,      :  
+	//         
+	BasicImage Crop(Rect rect) const
+	{
+		CheckRect(rect);
+
+		BasicImage result{ rect.size };
+		const int size = static_cast<int>(TileSize);
+		if (rect.origin.x % size == 0 && rect.origin.y % size == 0)
+		{
+			const int firstX = rect.origin.x / size;
+			const int firstY = rect.origin.y / size;
+			for (int tileY = 0; tileY < result.m_tilesY; ++tileY)
+			{
+				for (int tileX = 0; tileX < result.m_tilesX; ++tileX)
+				{
+					result.m_tiles[result.GetTileIndex(tileX, tileY)] =
+						TileAt(GetTileIndex(firstX + tileX, firstY + tileY));
+				}
+			}
+			return result;
+		}
+
+		std::vector<uint32_t> row(static_cast<size_t>(rect.size.width));
+		for (int y = 0; y < rect.size.height; ++y)
+		{
+			ReadRowClamped(rect.origin.y + y, rect.origin.x, rect.size.width, row.data());
+			result.WriteRow(y, row.data());
+		}
+		return result;
+	}
+
+	//  src ,         at.  at
+	//    , ,  src ,  
+	//  src,        
+	void Paste(const BasicImage& src, Point at)
+	{
+		const int size = static_cast<int>(TileSize);
+		if (at.x % size != 0 || at.y % size != 0)
+		{
+			Blit(src, at);
+			return;
+		}
+		if (&src == this)
+		{
+			const BasicImage copy = src;
+			Paste(copy, at);
+			return;
+		}
+
+		const int left = std::max(at.x, 0);
+		const int right = std::min(at.x + src.m_imageSize.width, m_imageSize.width);
+		const int top = std::max(at.y, 0);
+		const int bottom = std::min(at.y + src.m_imageSize.height, m_imageSize.height);
+		if (left >= right || top >= bottom) return;
+
+		for (int tileY = top / size; tileY <= (bottom - 1) / size; ++tileY)
+		{
+			for (int tileX = left / size; tileX <= (right - 1) / size; ++tileX)
+			{
+				const auto index = GetTileIndex(tileX, tileY);
+				const auto srcIndex = src.GetTileIndex(tileX - at.x / size, tileY - at.y / size);
+				const auto& tile = src.TileAt(srcIndex);
+
+				//        src
+				const Point origin = GetTileOrigin(index);
+				const ImageSize extent = GetTileExtent(origin);
+				const int x0 = std::max(left, origin.x);
+				const int x1 = std::min(right, origin.x + extent.width);
+				const int y0 = std::max(top, origin.y);
+				const int y1 = std::min(bottom, origin.y + extent.height);
+				if (x1 - x0 == extent.width && y1 - y0 == extent.height)
+				{
+					if (!m_tiles[index].IsSharedWith(tile))
+					{
+						AssignTile(index, tile);
+					}
+					continue;
+				}
+
+				// at   :      
+				uint32_t row[TileSize];
+				auto& dst = WritableTile(index);
+				for (int y = y0; y < y1; ++y)
+				{
+					const Point local{ x0 - origin.x, y - origin.y };
+					tile->ReadRow(local, static_cast<unsigned>(x1 - x0), row);
+					dst--->WriteRow(local, static_cast<unsigned>(x1 - x0), row);
+				}
+			}
+		}
+	}
+
+	//   : func(Point, uint32_t*, size_t),  
+	//        
+	template <typename Func>
+	void ForEachRow(Func&& func)
+	{
+		std::vector<TilePixels<uint32_t>> row(static_cast<size_t>(m_tilesX));
+		for (int tileY = 0; tileY < m_tilesY; ++tileY)
+		{
+			for (int tileX = 0; tileX < m_tilesX; ++tileX)
+			{
+				row[static_cast<size_t>(tileX)] = WriteTilePixels(GetTileIndex(tileX, tileY));
+			}
+			VisitRows(row, func);
+		}
+	}
+
+	//    from  to ,   
+	// ;          
+	void FillRect(Point from, Point to, uint32_t color)
+	{
+		const int left = std::max(std::min(from.x, to.x), 0);
+		const int right = std::min(std::max(from.x, to.x), m_imageSize.width - 1);
+		const int top = std::max(std::min(from.y, to.y), 0);
+		const int bottom = std::min(std::max(from.y, to.y), m_imageSize.height - 1);
+		if (left > right || top > bottom) return;
+
+		const int size = static_cast<int>(Tile::SIZE);
+		for (int tileY = top / size; tileY <= bottom / size; ++tileY)
+		{
+			const int y0 = std::max(top, tileY * size);
+			const int y1 = std::min(bottom, tileY * size + size - 1);
+			for (int tileX = left / size; tileX <= right / size; ++tileX)
+			{
+				const int x0 = std::max(left, tileX * size);
+				const int x1 = std::min(right, tileX * size + size - 1);
+				const auto index = GetTileIndex(tileX, tileY);
+
+				const bool loaded = !m_source || m_materialized[index];
+				if (x1 - x0 + 1 == size && y1 - y0 + 1 == size)
+				{
+					//   :       
+					if (!loaded || !IsSolidTile(m_tiles[index], color))
+					{
+						AssignTile(index, CoW<Tile>{ color });
+					}
+					continue;
+				}
+
+				//         
+				if (IsSolidTile(std::as_const(*this).TileAt(index), color)) continue;
+
+				WritableTile(index)--->FillRect({ x0 - tileX * size, y0 - tileY * size },
+					static_cast<unsigned>(x1 - x0 + 1), static_cast<unsigned>(y1 - y0 + 1), color);
+			}
+		}
+	}
+
+	//  src ,         at
+	void Blit(const BasicImage& src, Point at)
+	{
+		CombineRows(src, at, [](uint32_t* dst, const uint32_t* row, size_t count) {
+			GetPixelKernels().copy(dst, row, count);
+		}, false);
+	}
+
+	//  src     - (source-over),
+	//    src     
+	void Blend(const BasicImage& src, Point at)
+	{
+		CombineRows(src, at, [](uint32_t* dst, const uint32_t* row, size_t count) {
+			GetPixelKernels().blend(dst, row, count);
+		}, true);
+	}
+
+	//     key  color
+	void ReplaceColor(uint32_t key, uint32_t color)
+	{
+		if (key == color) return;
+
+		const size_t tileArea = Tile::SIZE * Tile::SIZE;
+		for (size_t index = 0; index < m_tiles.size(); ++index)
+		{
+			const auto& tile = std::as_const(*this).TileAt(index);
+			if (const uint32_t* data = tile->GetData())
+			{
+				if (std::find(data, data + tileArea, key) == data + tileArea) continue;
+				GetPixelKernels().replace(WritableTile(index)--->GetMutableData(), tileArea, key, color);
+			}
+			else if (tile->GetPixel({ 0, 0 }) == key)
+			{
+				AssignTile(index, CoW<Tile>{ color });
+			}
+		}
+	}
+
+	//   ,       ;
+	//    
+	size_t CollapseSolidTiles()
+	{
+		size_t collapsed = 0;
+		for (size_t index = 0; index < m_tiles.size(); ++index)
+		{
+			if (m_source && !m_materialized[index]) continue;
+
+			auto& tile = m_tiles[index];
+			if (tile->IsSolid() || !tile->IsUniform()) continue;
+
+			if (tile.GetInstanceCount() == 1)
+			{
+				tile--->TryCollapse();
+			}
+			else
+			{
+				//      ,    
+				tile = CoW<Tile>{ tile->GetPixel({ 0, 0 }) };
+			}
+			++collapsed;
+		}
+		return collapsed;
+	}
+
+	//       (  
+	//   ,     interner);
+	//    
+	size_t Compact(TileInterner& interner)
+	{
+		size_t reclaimed = 0;
+		for (size_t index = 0; index < m_tiles.size(); ++index)
+		{
+			if (m_source && !m_materialized[index]) continue;
+			reclaimed += interner.Intern(m_tiles[index]);
+		}
+		return reclaimed;
 	}
 
 protected:
 	std::vector<CoW<Tile>>& GetTiles() 
 	{
+		for (size_t index = 0; index < m_tiles.size(); ++index)
+		{
+			Materialize(index);
+			m_tileVersions[index] = ++m_version;
+		}
 		return m_tiles;
 	}
 
 private:
+	friend class BasicImageView<TileSize>;
+
+	void Materialize(size_t index) const
+	{
+		if (!m_source || m_materialized[index]) return;
+
+		//         
+		m_tiles[index] = m_source->Load(index, !IsSoleSourceOwner());
+		m_materialized[index] = true;
+	}
+
+	size_t GetTileIndex(int tileX, int tileY) const noexcept
+	{
+		return static_cast<size_t>(tileY) * static_cast<size_t>(m_tilesX) + static_cast<size_t>(tileX);
+	}
+
+	Point GetTileOrigin(size_t index) const noexcept
+	{
+		const int tileX = static_cast<int>(index % static_cast<size_t>(m_tilesX));
+		const int tileY = static_cast<int>(index / static_cast<size_t>(m_tilesX));
+		return { tileX * static_cast<int>(TileSize), tileY * static_cast<int>(TileSize) };
+	}
+
+	ImageSize GetTileExtent(Point origin) const noexcept
+	{
+		return {
+			std::min(static_cast<int>(TileSize), m_imageSize.width - origin.x),
+			std::min(static_cast<int>(TileSize), m_imageSize.height - origin.y),
+		};
+	}
+
+	// solidRow -   TileSize    
+	TilePixels<const uint32_t> ReadTilePixels(size_t index, uint32_t* solidRow) const
+	{
+		const Point origin = GetTileOrigin(index);
+		const auto& tile = TileAt(index);
+		if (const uint32_t* data = tile->GetData())
+		{
+			return { origin, GetTileExtent(origin), data, TileSize };
+		}
+
+		std::fill_n(solidRow, TileSize, tile->GetPixel({ 0, 0 }));
+		return { origin, GetTileExtent(origin), solidRow, 0 };
+	}
+
+	TilePixels<uint32_t> WriteTilePixels(size_t index)
+	{
+		const Point origin = GetTileOrigin(index);
+		return { origin, GetTileExtent(origin), WritableTile(index)--->GetMutableData(), TileSize };
+	}
+
+	// tile,   rect
+	static TilePixels<const uint32_t> ClipTilePixels(TilePixels<const uint32_t> tile, Rect rect) noexcept
+	{
+		const int left = std::max(tile.origin.x, rect.origin.x);
+		const int top = std::max(tile.origin.y, rect.origin.y);
+		const int right = std::min(tile.origin.x + tile.size.width, rect.origin.x + rect.size.width);
+		const int bottom = std::min(tile.origin.y + tile.size.height, rect.origin.y + rect.size.height);
+		tile.data = tile.GetRow(top - tile.origin.y) + (left - tile.origin.x);
+		tile.origin = { left, top };
+		tile.size = { right - left, bottom - top };
+		return tile;
+	}
+
+	template <typename Pixel, typename Func>
+	static void VisitRows(const std::vector<TilePixels<Pixel>>& row, Func& func)
+	{
+		const int height = row.front().size.height;
+		for (int y = 0; y < height; ++y)
+		{
+			for (const auto& tile : row)
+			{
+				func(Point{ tile.origin.x, tile.origin.y + y }, tile.GetRow(y), static_cast<size_t>(tile.size.width));
+			}
+		}
+	}
+
+	//    op  src (  at)  :
+	// op(   ,  src, )
+	template <typename RowOp>
+	void CombineRows(const BasicImage& src, Point at, RowOp op, bool skipTransparent)
+	{
+		if (&src == this)
+		{
+			//     
+			const BasicImage copy = src;
+			CombineRows(copy, at, op, skipTransparent);
+			return;
+		}
+
+		const auto srcSize = src.GetImageSize();
+		const int left = std::max(at.x, 0);
+		const int right = std::min(at.x + srcSize.width, m_imageSize.width);
+		const int top = std::max(at.y, 0);
+		const int bottom = std::min(at.y + srcSize.height, m_imageSize.height);
+		if (left >= right || top >= bottom) return;
+
+		const int size = static_cast<int>(Tile::SIZE);
+		std::vector<uint32_t> row(static_cast<size_t>(srcSize.width));
+		for (int y = top; y < bottom; ++y)
+		{
+			src.ReadRow(y - at.y, row.data());
+			const int tileY = y / size;
+			for (int tileX = left / size; tileX <= (right - 1) / size; ++tileX)
+			{
+				const int x0 = std::max(left, tileX * size);
+				const int x1 = std::min(right, tileX * size + size);
+				const uint32_t* segment = row.data() + (x0 - at.x);
+				const auto count = static_cast<size_t>(x1 - x0);
+				if (skipTransparent && std::all_of(segment, segment + count, [](uint32_t c) { return c >> 24 == 0; })) continue;
+
+				const auto index = GetTileIndex(tileX, tileY);
+				uint32_t* data = WritableTile(index)--->GetMutableData();
+				op(data + (y - tileY * size) * size + (x0 - tileX * size), segment, count);
+			}
+		}
+	}
+
+	static ImageSize GetHalfSize(ImageSize size) noexcept
+	{
+		return { (size.width + 1) / 2, (size.height + 1) / 2 };
+	}
+
+	//   1..depth:  ,   
+	// (   )    
+	void UpdatePyramid(unsigned depth, PyramidFilter filter) const
+	{
+		if (filter != m_pyramidFilter)
+		{
+			m_pyramid.clear();
+			m_pyramidBuiltAt.clear();
+			m_pyramidFilter = filter;
+		}
+		//         
+		m_pyramid.reserve(depth);
+
+		for (size_t level = 0; level < depth; ++level)
+		{
+			const BasicImage& src = level == 0 ? *this : m_pyramid[level - 1];
+			if (level == m_pyramid.size())
+			{
+				m_pyramid.emplace_back(GetHalfSize(src.m_imageSize));
+				src.Downsample(m_pyramid.back(), filter, std::nullopt);
+				m_pyramidBuiltAt.push_back(src.m_version);
+			}
+			else if (m_pyramidBuiltAt[level] != src.m_version)
+			{
+				src.Downsample(m_pyramid[level], filter, m_pyramidBuiltAt[level]);
+				m_pyramidBuiltAt[level] = src.m_version;
+			}
+		}
+	}
+
+	//   dst ( ),   , 
+	//   since;  since -  
+	void Downsample(BasicImage& dst, PyramidFilter filter, std::optional<uint64_t> since) const
+	{
+		//        
+		const int halo = filter == PyramidFilter::Bilinear ? 1 : 0;
+		std::vector<bool> stale(dst.m_tiles.size(), !since);
+		for (size_t index = 0; since && index < m_tiles.size(); ++index)
+		{
+			if (m_tileVersions[index] <= *since) continue;
+
+			const int tileX = static_cast<int>(index % static_cast<size_t>(m_tilesX));
+			const int tileY = static_cast<int>(index / static_cast<size_t>(m_tilesX));
+			for (int y = std::max((tileY - halo) / 2, 0); y <= std::min((tileY + halo) / 2, dst.m_tilesY - 1); ++y)
+			{
+				for (int x = std::max((tileX - halo) / 2, 0); x <= std::min((tileX + halo) / 2, dst.m_tilesX - 1); ++x)
+				{
+					stale[dst.GetTileIndex(x, y)] = true;
+				}
+			}
+		}
+
+		const size_t windowSide = 2 * TileSize + 2;
+		std::vector<uint32_t> window(windowSide * windowSide);
+		//     ,    
+		CoW<Tile> solid{ 0u };
+		bool haveSolid = false;
+		for (size_t index = 0; index < stale.size(); ++index)
+		{
+			if (!stale[index]) continue;
+
+			const Point origin = dst.GetTileOrigin(index);
+			const ImageSize extent = dst.GetTileExtent(origin);
+			const int x0 = std::max(2 * origin.x - halo, 0);
+			const int x1 = std::min(2 * (origin.x + extent.width) - 1 + halo, m_imageSize.width - 1);
+			const int y0 = std::max(2 * origin.y - halo, 0);
+			const int y1 = std::min(2 * (origin.y + extent.height) - 1 + halo, m_imageSize.height - 1);
+
+			if (const auto color = GetSolidColor({ x0, y0 }, { x1, y1 }))
+			{
+				if (IsSolidTile(dst.m_tiles[index], *color)) continue;
+				if (!haveSolid || !IsSolidTile(solid, *color))
+				{
+					solid = CoW<Tile>{ *color };
+					haveSolid = true;
+				}
+				dst.AssignTile(index, solid);
+				continue;
+			}
+
+			//   :     
+			const int width = 2 * extent.width + 2 * halo;
+			const int height = 2 * extent.height + 2 * halo;
+			for (int y = 0; y < height; ++y)
+			{
+				const int srcY = std::clamp(2 * origin.y - halo + y, 0, m_imageSize.height - 1);
+				ReadRowClamped(srcY, 2 * origin.x - halo, width, window.data() + static_cast<size_t>(y) * width);
+			}
+
+			Tile tile;
+			uint32_t* data = tile.GetMutableData();
+			const auto& kernels = GetPixelKernels();
+			const auto count = static_cast<size_t>(extent.width);
+			for (int y = 0; y < extent.height; ++y)
+			{
+				const uint32_t* row = window.data() + static_cast<size_t>(2 * y) * width;
+				uint32_t* out = data + static_cast<size_t>(y) * TileSize;
+				if (filter == PyramidFilter::Bilinear)
+				{
+					const uint32_t* rows[4]{ row, row + width, row + 2 * width, row + 3 * width };
+					kernels.downsampleBilinear(out, rows, count);
+				}
+				else
+				{
+					kernels.downsampleBox(out, row, row + width, count);
+				}
+			}
+			dst.AssignTile(index, CoW<Tile>(std::move(tile)));
+		}
+	}
+
+	//   [from; to],   ,   ,    
+	std::optional<uint32_t> GetSolidColor(Point from, Point to) const
+	{
+		const int size = static_cast<int>(Tile::SIZE);
+		std::optional<uint32_t> color;
+		for (int tileY = from.y / size; tileY <= to.y / size; ++tileY)
+		{
+			for (int tileX = from.x / size; tileX <= to.x / size; ++tileX)
+			{
+				const auto& tile = TileAt(GetTileIndex(tileX, tileY));
+				if (!tile->IsSolid() || (color && tile->GetPixel({ 0, 0 }) != *color)) return std::nullopt;
+				color = tile->GetPixel({ 0, 0 });
+			}
+		}
+		return color;
+	}
+
+	// count   y,   x0;     .
+	//     
+	void ReadRowClamped(int y, int x0, int count, uint32_t* dst) const
+	{
+		const int size = static_cast<int>(Tile::SIZE);
+		const int left = std::max(x0, 0);
+		const int right = std::min(x0 + count, m_imageSize.width);
+		const int tileY = y / size;
+		for (int x = left; x < right;)
+		{
+			const int tileX = x / size;
+			const int end = std::min(right, tileX * size + size);
+			TileAt(GetTileIndex(tileX, tileY))->ReadRow({ x - tileX * size, y - tileY * size },
+				static_cast<unsigned>(end - x), dst + (x - x0));
+			x = end;
+		}
+		std::fill(dst, dst + (left - x0), dst[left - x0]);
+		std::fill(dst + (right - x0), dst + count, dst[right - x0 - 1]);
+	}
+
+	//  rect   
+	void CheckRect(Rect rect) const
+	{
+		if (rect.size.width <= 0 || rect.size.height <= 0 || rect.origin.x < 0 || rect.origin.y < 0
+			|| rect.size.width > m_imageSize.width - rect.origin.x || rect.size.height > m_imageSize.height - rect.origin.y)
+		{
+			throw std::out_of_range("Rect is out of image");
+		}
+	}
+
+	void CheckTileIndex(size_t index) const
+	{
+		if (index >= m_tiles.size())
+		{
+			throw std::out_of_range("Tile index is out of image");
+		}
+	}
+
+	void AssignTile(size_t index, CoW<Tile> tile)
+	{
+		Touch(index);
+		m_tiles[index] = std::move(tile);
+		if (m_source && !m_materialized[index])
+		{
+			m_materialized[index] = true;
+			if (IsSoleSourceOwner())
+			{
+				m_source->Release(index);
+			}
+		}
+	}
+
+	static bool IsSolidTile(const CoW<Tile>& tile, uint32_t color) noexcept
+	{
+		return tile->IsSolid() && tile->GetPixel({ 0, 0 }) == color;
+	}
+
+	const CoW<Tile>& TileAt(size_t index) const
+	{
+		Materialize(index);
+		return m_tiles[index];
+	}
+
+	// ,     :  
+	CoW<Tile>& WritableTile(size_t index)
+	{
+		Materialize(index);
+		Touch(index);
+		auto& tile = m_tiles[index];
+		//  ,     ,  
+		if (m_source && tile.GetInstanceCount() > 1 && IsSoleSourceOwner())
+		{
+			m_source->Release(index);
+		}
+		//      
+		if (CoWCounters::IsEnabled() && tile.GetInstanceCount() > 1)
+		{
+			++m_cowStats.unshareCopies;
+			m_cowStats.bytesCopied += tile->GetByteSize();
+		}
+		return tile;
+	}
+
+	bool IsSoleSourceOwner() const noexcept
+	{
+		return m_source.use_count() == 1;
+	}
+
+	void Touch(size_t index) noexcept
+	{
+		m_dirty[index] = true;
+		m_tileVersions[index] = ++m_version;
+	}
+
 	ImageSize m_imageSize{};
 	int m_tilesX{};
 	int m_tilesY{};
-	std::vector<CoW<Tile>> m_tiles;
-};
\ No newline at end of file
+	//       const-,  
+	//  ITileSource       
+	mutable std::vector<CoW<Tile>> m_tiles;
+	std::shared_ptr<TileCache> m_source;
+	mutable std::vector<bool> m_materialized;
+	// ,    ClearDirtyTiles()
+	std::vector<bool> m_dirty;
+	// m_version    ,      
+	std::vector<uint64_t> m_tileVersions;
+	uint64_t m_version{};
+	//         
+	mutable std::vector<BasicImage> m_pyramid;
+	mutable std::vector<uint64_t> m_pyramidBuiltAt;
+	mutable PyramidFilter m_pyramidFilter{};
+	CoWStats m_cowStats;
+};
+
+//      :   ,
+//      
+template <unsigned TileSize>
+class BasicImageView
+{
+public:
+	BasicImageView(const BasicImage<TileSize>& image, Rect rect)
+		: m_image(&image)
+		, m_rect(rect)
+	{
+		image.CheckRect(rect);
+	}
+
+	ImageSize GetImageSize() const noexcept
+	{
+		return m_rect.size;
+	}
+
+	//    
+	Rect GetRect() const noexcept
+	{
+		return m_rect;
+	}
+
+	const BasicImage<TileSize>& GetImage() const noexcept
+	{
+		return *m_image;
+	}
+
+	uint32_t GetPixel(Point p) const
+	{
+		if (!IsPointInImage(p, m_rect.size)) return 0;
+		return m_image->GetPixel({ m_rect.origin.x + p.x, m_rect.origin.y + p.y });
+	}
+
+	//  BasicImage::ForEachRow,   -   
+	template <typename Func>
+	void ForEachRow(Func&& func) const
+	{
+		m_image->ForEachRow(m_rect, [this, &func](Point start, const uint32_t* pixels, size_t count) {
+			func(Point{ start.x - m_rect.origin.x, start.y - m_rect.origin.y }, pixels, count);
+		});
+	}
+
+	// rect -   
+	BasicImageView View(Rect rect) const
+	{
+		if (rect.origin.x < 0 || rect.origin.y < 0
+			|| rect.size.width > m_rect.size.width - rect.origin.x || rect.size.height > m_rect.size.height - rect.origin.y)
+		{
+			throw std::out_of_range("Rect is out of view");
+		}
+		return { *m_image, { { m_rect.origin.x + rect.origin.x, m_rect.origin.y + rect.origin.y }, rect.size } };
+	}
+
+	BasicImage<TileSize> Crop() const
+	{
+		return m_image->Crop(m_rect);
+	}
+
+private:
+	const BasicImage<TileSize>* m_image;
+	Rect m_rect;
+};
+
+using Image = BasicImage<Tile::SIZE>;
+using ImageView = BasicImageView<Tile::SIZE>;
\ No newline at end of file
@@ -0,0 +1,311 @@
+#pragma once
+
+#include "Image.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <optional>
+#include <variant>
+#include <vector>
+
+//      .  
+// ,  Evaluate         
+//   ,      .   
+//        
+template <unsigned TileSize>
+class BasicImageExpr
+{
+public:
+	using Image = BasicImage<TileSize>;
+	using Tile = BasicTile<TileSize>;
+
+	//  source    
+	explicit BasicImageExpr(Image source)
+		: m_source(std::move(source))
+	{
+	}
+
+	ImageSize GetImageSize() const noexcept
+	{
+		return m_source.GetImageSize();
+	}
+
+	size_t GetStepCount() const noexcept
+	{
+		return m_steps.size();
+	}
+
+	// func(uint32_t ) -> uint32_t,    
+	template <typename Func>
+	BasicImageExpr& Map(Func func)
+	{
+		//     ,   
+		m_steps.emplace_back(MapStep{
+			[func](uint32_t* pixels) {
+				for (size_t i = 0; i < TILE_AREA; ++i)
+				{
+					pixels[i] = func(pixels[i]);
+				}
+			},
+			func,
+		});
+		return *this;
+	}
+
+	BasicImageExpr& ReplaceColor(uint32_t key, uint32_t color)
+	{
+		m_steps.emplace_back(MapStep{
+			[key, color](uint32_t* pixels) {
+				GetPixelKernels().replace(pixels, TILE_AREA, key, color);
+			},
+			[key, color](uint32_t pixel) {
+				return pixel == key ? color : pixel;
+			},
+		});
+		return *this;
+	}
+
+	//   , - 
+	BasicImageExpr& Invert()
+	{
+		return Map([](uint32_t color) { return color ^ 0x00FFFFFF; });
+	}
+
+	//    (0.3 R + 0.59 G + 0.11 B)   level 
+	//  above,  - below
+	BasicImageExpr& Threshold(uint8_t level, uint32_t below, uint32_t above)
+	{
+		return Map([level, below, above](uint32_t color) {
+			const uint32_t luma = ((color >> 16 & 0xFF) * 77 + (color >> 8 & 0xFF) * 150 + (color & 0xFF) * 29) >> 8;
+			return luma >= level ? above : below;
+		});
+	}
+
+	//  BasicImage::Blit  BasicImage::Blend, overlay   at
+	BasicImageExpr& Blit(Image overlay, Point at)
+	{
+		m_steps.emplace_back(OverlayStep{ std::move(overlay), at, false });
+		return *this;
+	}
+
+	BasicImageExpr& Blend(Image overlay, Point at)
+	{
+		m_steps.emplace_back(OverlayStep{ std::move(overlay), at, true });
+		return *this;
+	}
+
+	//  -  ,   .  - 
+	// ,     :   
+	//    
+	Image Evaluate() const
+	{
+		return EvaluateRows([](size_t count, const auto& func) {
+			for (size_t i = 0; i < count; ++i)
+			{
+				func(i);
+			}
+		});
+	}
+
+	//      pool
+	Image Evaluate(ThreadPool& pool) const
+	{
+		return EvaluateRows([&pool](size_t count, const auto& func) {
+			pool.ParallelFor(count, func);
+		});
+	}
+
+private:
+	static constexpr size_t TILE_AREA = Tile::SIZE * Tile::SIZE;
+
+	//    ,  -   
+	struct MapStep
+	{
+		std::function<void(uint32_t* pixels)> applyTile;
+		std::function<uint32_t(uint32_t color)> applyColor;
+	};
+
+	struct OverlayStep
+	{
+		Image image;
+		Point at;
+		bool blend;
+	};
+
+	using Step = std::variant<MapStep, OverlayStep>;
+
+	template <typename ForEach>
+	Image EvaluateRows(ForEach&& forEach) const
+	{
+		// ,       , 
+		//    :    
+		Preload(m_source);
+		for (const auto& step : m_steps)
+		{
+			if (const auto* overlay = std::get_if<OverlayStep>(&step))
+			{
+				Preload(overlay->image);
+			}
+		}
+
+		// nullopt -   
+		const auto grid = static_cast<size_t>(m_source.GetTileGridSize().width);
+		std::vector<std::optional<CoW<Tile>>> tiles(m_source.GetTileCount());
+		forEach(static_cast<size_t>(m_source.GetTileGridSize().height), [this, grid, &tiles](size_t tileY) {
+			for (size_t index = tileY * grid; index < (tileY + 1) * grid; ++index)
+			{
+				tiles[index] = EvaluateTile(index);
+			}
+		});
+
+		//         
+		Image result = m_source;
+		std::optional<CoW<Tile>> lastSolid;
+		for (size_t index = 0; index < tiles.size(); ++index)
+		{
+			if (!tiles[index]) continue;
+
+			auto& tile = *tiles[index];
+			if (tile->IsSolid())
+			{
+				if (lastSolid && (*lastSolid)->GetPixel({ 0, 0 }) == tile->GetPixel({ 0, 0 }))
+				{
+					tile = *lastSolid;
+				}
+				lastSolid = tile;
+			}
+			result.SetTile(index, std::move(tile));
+		}
+		return result;
+	}
+
+	static void Preload(const Image& image)
+	{
+		for (size_t index = 0; index < image.GetTileCount(); ++index)
+		{
+			image.GetTile(index);
+		}
+	}
+
+	std::optional<CoW<Tile>> EvaluateTile(size_t index) const
+	{
+		const auto& tile = m_source.GetTile(index);
+		if (m_steps.empty()) return std::nullopt;
+
+		const Rect bounds = GetTileBounds(index);
+		if (tile->IsSolid() && !HasOverlay(bounds))
+		{
+			uint32_t color = tile->GetPixel({ 0, 0 });
+			for (const auto& step : m_steps)
+			{
+				//    
+				if (const auto* map = std::get_if<MapStep>(&step))
+				{
+					color = map->applyColor(color);
+				}
+			}
+			if (color == tile->GetPixel({ 0, 0 })) return std::nullopt;
+			return CoW<Tile>{ color };
+		}
+
+		//     ,      
+		CoW<Tile> result = tile;
+		uint32_t* data = result--->GetMutableData();
+		for (const auto& step : m_steps)
+		{
+			if (const auto* map = std::get_if<MapStep>(&step))
+			{
+				map->applyTile(data);
+			}
+			else
+			{
+				ApplyOverlay(std::get<OverlayStep>(step), bounds, data);
+			}
+		}
+		// ,    ,    
+		if (*result == *tile) return std::nullopt;
+		return result;
+	}
+
+	Rect GetTileBounds(size_t index) const noexcept
+	{
+		const auto size = GetImageSize();
+		const auto grid = static_cast<size_t>(m_source.GetTileGridSize().width);
+		const Point origin{
+			static_cast<int>(index % grid) * static_cast<int>(TileSize),
+			static_cast<int>(index / grid) * static_cast<int>(TileSize),
+		};
+		return { origin, {
+			std::min(static_cast<int>(TileSize), size.width - origin.x),
+			std::min(static_cast<int>(TileSize), size.height - origin.y),
+		} };
+	}
+
+	//  bounds  ,  - nullopt
+	static std::optional<Rect> GetOverlayArea(const OverlayStep& overlay, Rect bounds) noexcept
+	{
+		const auto size = overlay.image.GetImageSize();
+		const int left = std::max(bounds.origin.x, overlay.at.x);
+		const int top = std::max(bounds.origin.y, overlay.at.y);
+		const int right = std::min(bounds.origin.x + bounds.size.width, overlay.at.x + size.width);
+		const int bottom = std::min(bounds.origin.y + bounds.size.height, overlay.at.y + size.height);
+		if (left >= right || top >= bottom) return std::nullopt;
+		return Rect{ { left, top }, { right - left, bottom - top } };
+	}
+
+	bool HasOverlay(Rect bounds) const noexcept
+	{
+		return std::any_of(m_steps.begin(), m_steps.end(), [bounds](const Step& step) {
+			const auto* overlay = std::get_if<OverlayStep>(&step);
+			return overlay && GetOverlayArea(*overlay, bounds);
+		});
+	}
+
+	// data -     bounds
+	static void ApplyOverlay(const OverlayStep& overlay, Rect bounds, uint32_t* data)
+	{
+		const auto area = GetOverlayArea(overlay, bounds);
+		if (!area) return;
+
+		const auto& kernels = GetPixelKernels();
+		const auto count = static_cast<size_t>(area->size.width);
+		std::array<uint32_t, TileSize> row{};
+		for (int y = area->origin.y; y < area->origin.y + area->size.height; ++y)
+		{
+			ReadOverlayRow(overlay.image, { area->origin.x - overlay.at.x, y - overlay.at.y }, count, row.data());
+			uint32_t* dst = data + static_cast<size_t>(y - bounds.origin.y) * TileSize + (area->origin.x - bounds.origin.x);
+			if (overlay.blend)
+			{
+				kernels.blend(dst, row.data(), count);
+			}
+			else
+			{
+				kernels.copy(dst, row.data(), count);
+			}
+		}
+	}
+
+	//         
+	static void ReadOverlayRow(const Image& image, Point from, size_t count, uint32_t* dst)
+	{
+		const auto grid = static_cast<size_t>(image.GetTileGridSize().width);
+		const int size = static_cast<int>(TileSize);
+		while (count > 0)
+		{
+			const Point local{ from.x % size, from.y % size };
+			const auto part = std::min(count, static_cast<size_t>(size - local.x));
+			const size_t index = static_cast<size_t>(from.y / size) * grid + static_cast<size_t>(from.x / size);
+			image.GetTile(index)->ReadRow(local, static_cast<unsigned>(part), dst);
+			from.x += static_cast<int>(part);
+			dst += part;
+			count -= part;
+		}
+	}
+
+	Image m_source;
+	std::vector<Step> m_steps;
+};
+
+using ImageExpr = BasicImageExpr<Tile::SIZE>;
\ No newline at end of file
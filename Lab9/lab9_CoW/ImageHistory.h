@@ -0,0 +1,211 @@
+#pragma once
+
+#include "Image.h"
+
+#include <deque>
+#include <stdexcept>
+#include <vector>
+
+//   .    , 
+//   (   ),   
+//    ,     
+template <unsigned TileSize>
+class BasicImageHistory
+{
+public:
+	using Image = BasicImage<TileSize>;
+	using Tile = BasicTile<TileSize>;
+
+	static constexpr size_t DEFAULT_BYTE_BUDGET = 64 * 1024 * 1024;
+
+	explicit BasicImageHistory(const Image& initial, size_t byteBudget = DEFAULT_BYTE_BUDGET)
+		: m_current(initial)
+		, m_byteBudget(byteBudget)
+	{
+	}
+
+	//  image     ,   Redo .
+	//  false,      
+	bool Commit(const Image& image)
+	{
+		Delta delta;
+		for (size_t index : image.GetChangedTiles(m_current))
+		{
+			// Compact        
+			if (*m_current.GetTile(index) == *image.GetTile(index)) continue;
+			delta.tiles.push_back({ index, m_current.GetTile(index), image.GetTile(index) });
+			delta.bytes += sizeof(DeltaTile) + m_current.GetTile(index)->GetByteSize();
+		}
+		if (delta.tiles.empty()) return false;
+
+		while (m_deltas.size() > m_position)
+		{
+			DropNewest();
+		}
+		m_deltas.push_back(std::move(delta));
+		m_bytes += m_deltas.back().bytes;
+		++m_position;
+		m_current = image;
+
+		EnforceBudget();
+		return true;
+	}
+
+	bool CanUndo() const noexcept
+	{
+		return m_position > 0;
+	}
+
+	bool CanRedo() const noexcept
+	{
+		return m_position < m_deltas.size();
+	}
+
+	const Image& Undo()
+	{
+		if (!CanUndo())
+		{
+			throw std::logic_error("Nothing to undo");
+		}
+
+		--m_position;
+		for (const auto& tile : m_deltas[m_position].tiles)
+		{
+			m_current.SetTile(tile.index, tile.before);
+		}
+		return m_current;
+	}
+
+	const Image& Redo()
+	{
+		if (!CanRedo())
+		{
+			throw std::logic_error("Nothing to redo");
+		}
+
+		for (const auto& tile : m_deltas[m_position].tiles)
+		{
+			m_current.SetTile(tile.index, tile.after);
+		}
+		++m_position;
+		return m_current;
+	}
+
+	const Image& JumpTo(size_t version)
+	{
+		if (version < GetOldestVersion() || version > GetNewestVersion())
+		{
+			throw std::out_of_range("Version is not in history");
+		}
+
+		while (GetCurrentVersion() > version)
+		{
+			Undo();
+		}
+		while (GetCurrentVersion() < version)
+		{
+			Redo();
+		}
+		return m_current;
+	}
+
+	const Image& GetCurrent() const noexcept
+	{
+		return m_current;
+	}
+
+	//       
+	size_t GetCurrentVersion() const noexcept
+	{
+		return m_firstVersion + m_position;
+	}
+
+	size_t GetOldestVersion() const noexcept
+	{
+		return m_firstVersion;
+	}
+
+	size_t GetNewestVersion() const noexcept
+	{
+		return m_firstVersion + m_deltas.size();
+	}
+
+	// ,    version  
+	std::vector<size_t> GetChangedTiles(size_t version) const
+	{
+		if (version <= GetOldestVersion() || version > GetNewestVersion())
+		{
+			throw std::out_of_range("Version has no recorded changes");
+		}
+
+		std::vector<size_t> indices;
+		for (const auto& tile : m_deltas[version - m_firstVersion - 1].tiles)
+		{
+			indices.push_back(tile.index);
+		}
+		return indices;
+	}
+
+	//    :      
+	size_t GetByteSize() const noexcept
+	{
+		return m_bytes;
+	}
+
+	size_t GetByteBudget() const noexcept
+	{
+		return m_byteBudget;
+	}
+
+	void SetByteBudget(size_t byteBudget)
+	{
+		m_byteBudget = byteBudget;
+		EnforceBudget();
+	}
+
+private:
+	struct DeltaTile
+	{
+		size_t index;
+		CoW<Tile> before;
+		CoW<Tile> after;
+	};
+
+	struct Delta
+	{
+		std::vector<DeltaTile> tiles;
+		size_t bytes = 0;
+	};
+
+	//     ,    Redo;
+	//    
+	void EnforceBudget()
+	{
+		while (m_bytes > m_byteBudget && m_position > 0)
+		{
+			m_bytes -= m_deltas.front().bytes;
+			m_deltas.pop_front();
+			--m_position;
+			++m_firstVersion;
+		}
+		while (m_bytes > m_byteBudget && CanRedo())
+		{
+			DropNewest();
+		}
+	}
+
+	void DropNewest()
+	{
+		m_bytes -= m_deltas.back().bytes;
+		m_deltas.pop_back();
+	}
+
+	Image m_current;
+	std::deque<Delta> m_deltas;
+	size_t m_position = 0;
+	size_t m_firstVersion = 0;
+	size_t m_bytes = 0;
+	size_t m_byteBudget;
+};
+
+using ImageHistory = BasicImageHistory<Tile::SIZE>;
\ No newline at end of file
@@ -0,0 +1,229 @@
+#pragma once
+
+#include "Image.h"
+#include "ThreadPool.h"
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+//      ARGB (0xAARRGGBB)
+enum class Channel
+{
+	Blue,
+	Green,
+	Red,
+	Alpha,
+};
+
+struct ImageHistogram
+{
+	std::array<std::array<uint64_t, 256>, 4> bins{};
+	uint64_t pixelCount = 0;
+
+	const std::array<uint64_t, 256>& operator[](Channel channel) const noexcept
+	{
+		return bins[static_cast<size_t>(channel)];
+	}
+};
+
+struct ChannelStats
+{
+	uint8_t min = 0;
+	uint8_t max = 0;
+	double mean = 0;
+};
+
+struct ImageStats
+{
+	std::array<ChannelStats, 4> channels{};
+	uint64_t pixelCount = 0;
+
+	const ChannelStats& operator[](Channel channel) const noexcept
+	{
+		return channels[static_cast<size_t>(channel)];
+	}
+};
+
+namespace stats
+{
+	// 32-     ImageHistogram::bins
+	using Bins = std::array<uint32_t, 4 * 256>;
+
+	inline void AddColor(ImageHistogram& histogram, uint32_t color, uint64_t count) noexcept
+	{
+		for (size_t channel = 0; channel < 4; ++channel)
+		{
+			histogram.bins[channel][color >> (8 * channel) & 0xFF] += count;
+		}
+	}
+
+	inline void AddBins(ImageHistogram& histogram, const Bins& bins, uint64_t weight) noexcept
+	{
+		for (size_t channel = 0; channel < 4; ++channel)
+		{
+			for (size_t value = 0; value < 256; ++value)
+			{
+				histogram.bins[channel][value] += bins[channel * 256 + value] * weight;
+			}
+		}
+	}
+} // namespace stats
+
+//     .    
+// ,          ,
+//     ;      pool
+template <unsigned TileSize>
+ImageHistogram ComputeHistogram(const BasicImage<TileSize>& img, ThreadPool& pool)
+{
+	using Tile = BasicTile<TileSize>;
+
+	struct Work
+	{
+		const Tile* tile;
+		ImageSize extent;
+		uint64_t weight;
+	};
+
+	ImageHistogram histogram;
+	const auto size = img.GetImageSize();
+	histogram.pixelCount = static_cast<uint64_t>(size.width) * static_cast<uint64_t>(size.height);
+
+	//     : GetTile     .
+	//     ,    
+	std::vector<Work> work;
+	std::unordered_map<const Tile*, size_t> shared;
+	const auto grid = img.GetTileGridSize();
+	const int side = static_cast<int>(TileSize);
+	for (int tileY = 0; tileY < grid.height; ++tileY)
+	{
+		for (int tileX = 0; tileX < grid.width; ++tileX)
+		{
+			const auto& tile = img.GetTile(static_cast<size_t>(tileY) * static_cast<size_t>(grid.width) + static_cast<size_t>(tileX));
+			const ImageSize extent{
+				std::min(side, size.width - tileX * side),
+				std::min(side, size.height - tileY * side),
+			};
+			if (tile->IsSolid())
+			{
+				stats::AddColor(histogram, tile->GetPixel({ 0, 0 }),
+					static_cast<uint64_t>(extent.width) * static_cast<uint64_t>(extent.height));
+				continue;
+			}
+
+			if (extent.width == side && extent.height == side)
+			{
+				const auto [it, inserted] = shared.try_emplace(&*tile, work.size());
+				if (!inserted)
+				{
+					++work[it->second].weight;
+					continue;
+				}
+			}
+			work.push_back({ &*tile, extent, 1 });
+		}
+	}
+
+	//     ,       
+	const size_t chunkCount = std::min(work.size(), static_cast<size_t>(pool.GetThreadCount()) * 4);
+	std::mutex mutex;
+	pool.ParallelFor(chunkCount, [&](size_t chunk) {
+		const auto& kernels = GetPixelKernels();
+		ImageHistogram local;
+		stats::Bins bins{};
+		stats::Bins weighted{};
+		uint64_t binned = 0;
+		for (size_t i = work.size() * chunk / chunkCount; i < work.size() * (chunk + 1) / chunkCount; ++i)
+		{
+			const auto& item = work[i];
+			const uint32_t* data = item.tile->GetData();
+			auto& target = item.weight == 1 ? bins : weighted;
+			if (item.extent.width == side && item.extent.height == side)
+			{
+				kernels.histogram(target.data(), data, Tile::SIZE * Tile::SIZE);
+			}
+			else
+			{
+				for (int y = 0; y < item.extent.height; ++y)
+				{
+					kernels.histogram(target.data(), data + static_cast<size_t>(y) * Tile::SIZE, static_cast<size_t>(item.extent.width));
+				}
+			}
+
+			if (item.weight > 1)
+			{
+				stats::AddBins(local, weighted, item.weight);
+				weighted.fill(0);
+			}
+			// 32-     
+			else if ((binned += Tile::SIZE * Tile::SIZE) >= (uint64_t{ 1 } << 31))
+			{
+				stats::AddBins(local, bins, 1);
+				bins.fill(0);
+				binned = 0;
+			}
+		}
+		stats::AddBins(local, bins, 1);
+
+		std::lock_guard lock{ mutex };
+		for (size_t channel = 0; channel < 4; ++channel)
+		{
+			for (size_t value = 0; value < 256; ++value)
+			{
+				histogram.bins[channel][value] += local.bins[channel][value];
+			}
+		}
+	});
+	return histogram;
+}
+
+//    GetDefaultThreadPool()
+template <unsigned TileSize>
+ImageHistogram ComputeHistogram(const BasicImage<TileSize>& img)
+{
+	return ComputeHistogram(img, GetDefaultThreadPool());
+}
+
+// ,        
+inline ImageStats ComputeStats(const ImageHistogram& histogram)
+{
+	ImageStats result;
+	result.pixelCount = histogram.pixelCount;
+	if (histogram.pixelCount == 0) return result;
+
+	for (size_t channel = 0; channel < 4; ++channel)
+	{
+		const auto& bins = histogram.bins[channel];
+		auto& stats = result.channels[channel];
+		uint64_t sum = 0;
+		bool found = false;
+		for (size_t value = 0; value < 256; ++value)
+		{
+			if (bins[value] == 0) continue;
+
+			if (!found)
+			{
+				stats.min = static_cast<uint8_t>(value);
+				found = true;
+			}
+			stats.max = static_cast<uint8_t>(value);
+			sum += bins[value] * value;
+		}
+		stats.mean = static_cast<double>(sum) / static_cast<double>(histogram.pixelCount);
+	}
+	return result;
+}
+
+template <unsigned TileSize>
+ImageStats ComputeStats(const BasicImage<TileSize>& img, ThreadPool& pool)
+{
+	return ComputeStats(ComputeHistogram(img, pool));
+}
+
+template <unsigned TileSize>
+ImageStats ComputeStats(const BasicImage<TileSize>& img)
+{
+	return ComputeStats(ComputeHistogram(img));
+}
\ No newline at end of file
@@ -1,24 +1,37 @@
 #pragma once
 
 #include "Image.h"
+#include "MappedFile.h"
 
+#include <array>
+#include <cctype>
+#include <charconv>
 #include <fstream>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
 
-inline void PrintImage(const Image& img, std::ostream& osas)
+template <unsigned TileSize>
+void PrintImage(const BasicImage<TileSize>& img, std::ostream& osas)
 {
-	const auto imgSize = img.GetImageSize();
-	for (int y = 0; y < imgSize.height; ++y)
-	{
-		for (int x = 0; x < imgSize.width; ++x)
+	const int width = img.GetImageSize().width;
+	img.ForEachRow([&osas, width](Point start, const uint32_t* pixels, size_t count) {
+		for (size_t i = 0; i < count; ++i)
 		{
-			uint32_t color = img.GetPixel({ x, y });
-			osas.put(static_cast<char>(color & 0xFF));
+			osas.put(static_cast<char>(pixels[i] & 0xFF));
 		}
-		osas.put('\n');
-	}
+		if (start.x + static_cast<int>(count) == width)
+		{
+			osas.put('\n');
+		}
+	});
 }
 
-inline Image LoadImage(const std::string& pixels)
+// ImageT - Image  BasicImage    
+template <typename ImageT = Image>
+ImageT LoadImage(const std::string& pixels)
 {
 	std::istringstream isus{ pixels };
 	ImageSize size{};
@@ -30,78 +43,689 @@ inline Image LoadImage(const std::string& pixels)
 		++size.height;
 	}
 
-	Image img{ size };
+	ImageT img{ size };
 	isus.clear();
 	isus.str(pixels);
+	std::vector<uint32_t> row(static_cast<size_t>(size.width));
 	for (int y = 0; y < size.height; ++y)
 	{
 		if (!std::getline(isus, str)) break;
 
-		int x = 0;
-		for (char ch : str)
+		std::fill(row.begin(), row.end(), 0);
+		std::transform(str.begin(), str.end(), row.begin(), [](char ch) {
+			return static_cast<uint32_t>(static_cast<unsigned char>(ch));
+		});
+		img.WriteRow(y, row.data());
+	}
+
+	return img;
+}
+
+enum class PpmFormat
+{
+	Plain, // P3, 
+	Raw,   // P6, 
+};
+
+namespace detail
+{
+	inline void SkipPpmSpaces(std::istream& isus)
+	{
+		for (int ch = isus.peek(); ch != EOF; ch = isus.peek())
+		{
+			if (ch == '#')
+			{
+				isus.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+			}
+			else if (std::isspace(ch))
+			{
+				isus.get();
+			}
+			else
+			{
+				break;
+			}
+		}
+	}
+
+	inline int ReadPpmNumber(std::istream& isus)
+	{
+		SkipPpmSpaces(isus);
+		int value = 0;
+		if (!(isus >> value))
+		{
+			throw std::runtime_error("Invalid PPM header");
+		}
+		return value;
+	}
+
+	inline uint32_t PackRgb(int r, int g, int b, int maxv) noexcept
+	{
+		if (maxv != 0xFF && maxv > 0)
+		{
+			r = r * 0xFF / maxv;
+			g = g * 0xFF / maxv;
+			b = b * 0xFF / maxv;
+		}
+
+		return (static_cast<uint32_t>(r & 0xFF) << 16)
+			| (static_cast<uint32_t>(g & 0xFF) << 8)
+			| static_cast<uint32_t>(b & 0xFF);
+	}
+
+	template <unsigned TileSize>
+	void WriteRawRows(const BasicImage<TileSize>& img, std::ostream& osas)
+	{
+		const int width = img.GetImageSize().width;
+		std::vector<char> bytes(static_cast<size_t>(width) * 3);
+
+		//        ,   
+		img.ForEachRow([&](Point start, const uint32_t* pixels, size_t count) {
+			char* out = bytes.data() + static_cast<size_t>(start.x) * 3;
+			for (size_t i = 0; i < count; ++i)
+			{
+				*out++ = static_cast<char>(pixels[i] >> 16 & 0xFF);
+				*out++ = static_cast<char>(pixels[i] >> 8 & 0xFF);
+				*out++ = static_cast<char>(pixels[i] & 0xFF);
+			}
+			if (start.x + static_cast<int>(count) == width)
+			{
+				osas.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+			}
+		});
+	}
+
+	template <unsigned TileSize>
+	void WritePlainRows(const BasicImage<TileSize>& img, std::ostream& osas)
+	{
+		const int width = img.GetImageSize().width;
+		// "255 255 255\n" -   12   
+		std::vector<char> text(static_cast<size_t>(width) * 12);
+		char* out = text.data();
+		char* const end = text.data() + text.size();
+
+		img.ForEachRow([&](Point start, const uint32_t* pixels, size_t count) {
+			for (size_t i = 0; i < count; ++i)
+			{
+				out = std::to_chars(out, end, pixels[i] >> 16 & 0xFF).ptr;
+				*out++ = ' ';
+				out = std::to_chars(out, end, pixels[i] >> 8 & 0xFF).ptr;
+				*out++ = ' ';
+				out = std::to_chars(out, end, pixels[i] & 0xFF).ptr;
+				*out++ = '\n';
+			}
+			if (start.x + static_cast<int>(count) == width)
+			{
+				osas.write(text.data(), out - text.data());
+				out = text.data();
+			}
+		});
+	}
+
+	// P6:         
+	template <unsigned TileSize>
+	void ReadRawRows(BasicImage<TileSize>& img, std::istream& isus, int maxv)
+	{
+		const auto imageSize = img.GetImageSize();
+		const size_t sampleSize = maxv < 0x100 ? 1 : 2;
+		std::vector<unsigned char> bytes(static_cast<size_t>(imageSize.width) * 3 * sampleSize);
+		std::vector<uint32_t> row(static_cast<size_t>(imageSize.width));
+
+		for (int y = 0; y < imageSize.height; ++y)
+		{
+			if (!isus.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()))) break;
+
+			const unsigned char* in = bytes.data();
+			for (auto& color : row)
+			{
+				int rgb[3]{};
+				for (int& channel : rgb)
+				{
+					channel = sampleSize == 1 ? in[0] : in[0] << 8 | in[1];
+					in += sampleSize;
+				}
+				color = PackRgb(rgb[0], rgb[1], rgb[2], maxv);
+			}
+			img.WriteRow(y, row.data());
+		}
+	}
+
+	template <unsigned TileSize>
+	void ReadPlainRows(BasicImage<TileSize>& img, std::istream& isus, int maxv)
+	{
+		const auto imageSize = img.GetImageSize();
+		std::vector<uint32_t> row(static_cast<size_t>(imageSize.width));
+
+		for (int y = 0; y < imageSize.height; ++y)
+		{
+			bool complete = true;
+			std::fill(row.begin(), row.end(), 0);
+			for (auto& color : row)
+			{
+				int r = 0;
+				int g = 0;
+				int b = 0;
+				if (!(isus >> r >> g >> b))
+				{
+					complete = false;
+					break;
+				}
+				color = PackRgb(r, g, b, maxv);
+			}
+			img.WriteRow(y, row.data());
+
+			if (!complete) break;
+		}
+	}
+
+	// QOI (Quite OK Image): https://qoiformat.org/qoi-specification.pdf.
+	//    : ,   64  ,
+	//        
+	constexpr std::array<char, 4> QOI_MAGIC{ 'q', 'o', 'i', 'f' };
+	constexpr size_t QOI_HEADER_SIZE = 14;
+	constexpr std::array<char, 8> QOI_END{ 0, 0, 0, 0, 0, 0, 0, 1 };
+
+	constexpr unsigned char QOI_OP_INDEX = 0x00;
+	constexpr unsigned char QOI_OP_DIFF = 0x40;
+	constexpr unsigned char QOI_OP_LUMA = 0x80;
+	constexpr unsigned char QOI_OP_RUN = 0xC0;
+	constexpr unsigned char QOI_OP_RGB = 0xFE;
+	constexpr unsigned char QOI_OP_RGBA = 0xFF;
+	constexpr unsigned char QOI_MASK = 0xC0;
+	constexpr unsigned QOI_MAX_RUN = 62;
+	//    -  
+	constexpr uint32_t QOI_START = 0xFF000000;
+
+	inline size_t QoiHash(uint32_t argb) noexcept
+	{
+		const uint32_t r = argb >> 16 & 0xFF;
+		const uint32_t g = argb >> 8 & 0xFF;
+		const uint32_t b = argb & 0xFF;
+		const uint32_t a = argb >> 24;
+		return (r * 3 + g * 5 + b * 7 + a * 11) % 64;
+	}
+
+	//     256    
+	inline int QoiDelta(uint32_t lhs, uint32_t rhs, int shift) noexcept
+	{
+		return static_cast<signed char>(static_cast<unsigned char>((lhs >> shift) - (rhs >> shift)));
+	}
+
+	//      ,    .
+	//  -    
+	class QoiEncoder
+	{
+	public:
+		QoiEncoder(std::ostream& out, bool hasAlpha)
+			: m_out(out)
+			, m_alpha(hasAlpha ? 0 : QOI_START)
+		{
+			m_buffer.reserve(BUFFER_SIZE);
+		}
+
+		void Push(const uint32_t* pixels, size_t count)
+		{
+			for (size_t i = 0; i < count; ++i)
+			{
+				//   - QOI_OP_RUN  QOI_OP_RGBA
+				if (m_buffer.size() + 6 > BUFFER_SIZE)
+				{
+					FlushBuffer();
+				}
+
+				const uint32_t pixel = pixels[i] | m_alpha;
+				if (pixel == m_previous)
+				{
+					if (++m_run == QOI_MAX_RUN)
+					{
+						FlushRun();
+					}
+					continue;
+				}
+				FlushRun();
+				EncodePixel(pixel);
+				m_previous = pixel;
+			}
+		}
+
+		void Finish()
+		{
+			FlushRun();
+			m_buffer.insert(m_buffer.end(), QOI_END.begin(), QOI_END.end());
+			FlushBuffer();
+		}
+
+	private:
+		static constexpr size_t BUFFER_SIZE = 64 * 1024;
+
+		void Put(unsigned value)
+		{
+			m_buffer.push_back(static_cast<char>(value));
+		}
+
+		void FlushRun()
+		{
+			if (m_run == 0) return;
+			Put(QOI_OP_RUN | (m_run - 1));
+			m_run = 0;
+		}
+
+		void FlushBuffer()
+		{
+			m_out.write(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+			m_buffer.clear();
+		}
+
+		void EncodePixel(uint32_t pixel)
+		{
+			auto& seen = m_index[QoiHash(pixel)];
+			if (seen == pixel)
+			{
+				Put(QOI_OP_INDEX | static_cast<unsigned>(QoiHash(pixel)));
+				return;
+			}
+			seen = pixel;
+
+			if ((pixel ^ m_previous) >> 24 != 0)
+			{
+				Put(QOI_OP_RGBA);
+				Put(pixel >> 16 & 0xFF);
+				Put(pixel >> 8 & 0xFF);
+				Put(pixel & 0xFF);
+				Put(pixel >> 24);
+				return;
+			}
+
+			const int dr = QoiDelta(pixel, m_previous, 16);
+			const int dg = QoiDelta(pixel, m_previous, 8);
+			const int db = QoiDelta(pixel, m_previous, 0);
+			const int drg = dr - dg;
+			const int dbg = db - dg;
+			if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+			{
+				Put(QOI_OP_DIFF | static_cast<unsigned>((dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+			}
+			else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7)
+			{
+				Put(QOI_OP_LUMA | static_cast<unsigned>(dg + 32));
+				Put(static_cast<unsigned>((drg + 8) << 4 | (dbg + 8)));
+			}
+			else
+			{
+				Put(QOI_OP_RGB);
+				Put(pixel >> 16 & 0xFF);
+				Put(pixel >> 8 & 0xFF);
+				Put(pixel & 0xFF);
+			}
+		}
+
+		std::ostream& m_out;
+		uint32_t m_alpha;
+		std::vector<char> m_buffer;
+		std::array<uint32_t, 64> m_index{};
+		uint32_t m_previous = QOI_START;
+		unsigned m_run = 0;
+	};
+
+	//      ,   .
+	//  -    ,   PPM
+	class QoiDecoder
+	{
+	public:
+		QoiDecoder(std::istream& in, bool hasAlpha)
+			: m_in(in)
+			, m_mask(hasAlpha ? 0xFFFFFFFF : 0x00FFFFFF)
+			, m_buffer(64 * 1024)
+		{
+		}
+
+		void Pop(uint32_t* pixels, size_t count)
 		{
-			img.SetPixel({ x++, y }, static_cast<unsigned char>(ch));
+			for (size_t i = 0; i < count; ++i)
+			{
+				if (m_run > 0)
+				{
+					--m_run;
+				}
+				else
+				{
+					DecodePixel();
+				}
+				pixels[i] = m_previous & m_mask;
+			}
 		}
+
+	private:
+		unsigned Get()
+		{
+			if (m_position == m_size)
+			{
+				m_in.read(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+				m_size = static_cast<size_t>(m_in.gcount());
+				m_position = 0;
+				if (m_size == 0)
+				{
+					throw std::runtime_error("QOI data is truncated");
+				}
+			}
+			return static_cast<unsigned char>(m_buffer[m_position++]);
+		}
+
+		static uint32_t AddDelta(uint32_t pixel, int shift, int delta) noexcept
+		{
+			const uint32_t channel = ((pixel >> shift) + static_cast<uint32_t>(delta)) & 0xFF;
+			return (pixel & ~(uint32_t{ 0xFF } << shift)) | channel << shift;
+		}
+
+		void DecodePixel()
+		{
+			const unsigned op = Get();
+			uint32_t pixel = m_previous;
+			if (op == QOI_OP_RGB || op == QOI_OP_RGBA)
+			{
+				const unsigned r = Get();
+				const unsigned g = Get();
+				const unsigned b = Get();
+				const unsigned a = op == QOI_OP_RGBA ? Get() : pixel >> 24;
+				pixel = a << 24 | r << 16 | g << 8 | b;
+			}
+			else if ((op & QOI_MASK) == QOI_OP_INDEX)
+			{
+				pixel = m_index[op];
+			}
+			else if ((op & QOI_MASK) == QOI_OP_DIFF)
+			{
+				pixel = AddDelta(pixel, 16, static_cast<int>(op >> 4 & 3) - 2);
+				pixel = AddDelta(pixel, 8, static_cast<int>(op >> 2 & 3) - 2);
+				pixel = AddDelta(pixel, 0, static_cast<int>(op & 3) - 2);
+			}
+			else if ((op & QOI_MASK) == QOI_OP_LUMA)
+			{
+				const unsigned next = Get();
+				const int dg = static_cast<int>(op & 0x3F) - 32;
+				pixel = AddDelta(pixel, 16, dg - 8 + static_cast<int>(next >> 4));
+				pixel = AddDelta(pixel, 8, dg);
+				pixel = AddDelta(pixel, 0, dg - 8 + static_cast<int>(next & 0x0F));
+			}
+			else
+			{
+				//     m_run 
+				m_run = op & 0x3F;
+			}
+
+			m_index[QoiHash(pixel)] = pixel;
+			m_previous = pixel;
+		}
+
+		std::istream& m_in;
+		uint32_t m_mask;
+		std::vector<char> m_buffer;
+		size_t m_position = 0;
+		size_t m_size = 0;
+		std::array<uint32_t, 64> m_index{};
+		uint32_t m_previous = QOI_START;
+		unsigned m_run = 0;
+	};
+} // namespace detail
+
+//    - -. ,     
+//  (,  PPM),      ,
+//  -  , -   
+template <unsigned TileSize>
+void EncodeQoi(const BasicImage<TileSize>& img, std::ostream& out)
+{
+	uint32_t bits = 0;
+	img.ForEachRow([&bits](Point, const uint32_t* pixels, size_t count) {
+		bits = std::accumulate(pixels, pixels + count, bits, std::bit_or<>{});
+	});
+	const bool hasAlpha = bits >> 24 != 0;
+
+	const auto size = img.GetImageSize();
+	std::array<char, detail::QOI_HEADER_SIZE> header{};
+	std::copy(detail::QOI_MAGIC.begin(), detail::QOI_MAGIC.end(), header.begin());
+	for (int i = 0; i < 4; ++i)
+	{
+		header[4 + i] = static_cast<char>(static_cast<uint32_t>(size.width) >> (24 - 8 * i) & 0xFF);
+		header[8 + i] = static_cast<char>(static_cast<uint32_t>(size.height) >> (24 - 8 * i) & 0xFF);
+	}
+	header[12] = hasAlpha ? 4 : 3; // RGBA  RGB
+	header[13] = 0; // sRGB
+	out.write(header.data(), header.size());
+
+	//      
+	detail::QoiEncoder encoder{ out, hasAlpha };
+	img.ForEachRow([&encoder](Point, const uint32_t* pixels, size_t count) {
+		encoder.Push(pixels, count);
+	});
+	encoder.Finish();
+}
+
+template <typename ImageT = Image>
+ImageT DecodeQoi(std::istream& in)
+{
+	std::array<char, detail::QOI_HEADER_SIZE> header{};
+	if (!in.read(header.data(), header.size())
+		|| !std::equal(detail::QOI_MAGIC.begin(), detail::QOI_MAGIC.end(), header.begin()))
+	{
+		throw std::runtime_error("Not a QOI image");
+	}
+
+	uint32_t width = 0;
+	uint32_t height = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		width = width << 8 | static_cast<unsigned char>(header[4 + i]);
+		height = height << 8 | static_cast<unsigned char>(header[8 + i]);
+	}
+	const auto maxSize = static_cast<uint32_t>(std::numeric_limits<int>::max());
+	if (width == 0 || height == 0 || width > maxSize || height > maxSize || (header[12] != 3 && header[12] != 4))
+	{
+		throw std::runtime_error("Invalid QOI header");
 	}
 
+	ImageT img{ ImageSize{ static_cast<int>(width), static_cast<int>(height) } };
+	detail::QoiDecoder decoder{ in, header[12] == 4 };
+	std::vector<uint32_t> row(width);
+	for (int y = 0; y < img.GetImageSize().height; ++y)
+	{
+		decoder.Pop(row.data(), row.size());
+		img.WriteRow(y, row.data());
+	}
 	return img;
 }
 
-inline void SaveImage(const Image& img, const std::string& dst)
+template <unsigned TileSize>
+void SaveQoi(const BasicImage<TileSize>& img, const std::string& dst)
 {
+	img.ReleaseFile(dst);
 	std::ofstream osas{ dst, std::ios::binary };
+	if (!osas)
+	{
+		throw std::runtime_error("Failed to open " + dst);
+	}
+	EncodeQoi(img, osas);
+	if (!osas.flush())
+	{
+		throw std::runtime_error("Failed to write " + dst);
+	}
+}
+
+template <typename ImageT = Image>
+ImageT ImportQoi(const std::string& src)
+{
+	std::ifstream isus{ src, std::ios::binary };
+	if (!isus)
+	{
+		throw std::runtime_error("Failed to open " + src);
+	}
+	return DecodeQoi<ImageT>(isus);
+}
+
+template <unsigned TileSize>
+void SaveImage(const BasicImage<TileSize>& img, const std::string& dst, PpmFormat format = PpmFormat::Raw)
+{
+	//   MapImage(dst)         
+	img.ReleaseFile(dst);
+	std::ofstream osas{ dst, std::ios::binary };
+	if (!osas)
+	{
+		throw std::runtime_error("Failed to open " + dst);
+	}
+
 	const auto imageSize = img.GetImageSize();
-	osas << "P3\n" << imageSize.width << " " << imageSize.height << "\n255\n";
-	
-	for (int y = 0; y < imageSize.height; ++y)
+	osas << (format == PpmFormat::Raw ? "P6\n" : "P3\n")
+		<< imageSize.width << " " << imageSize.height << "\n255\n";
+
+	if (format == PpmFormat::Raw)
 	{
-		for (int x = 0; x < imageSize.width; ++x)
-		{
-			uint32_t color = img.GetPixel({ x, y });
-			unsigned r = color >> 16 & 0xFF;
-			unsigned g = color >> 8 & 0xFF;
-			unsigned b = color & 0xFF;
-			osas << r << " " << g << " " << b << "\n";
-		}
+		detail::WriteRawRows(img, osas);
+	}
+	else
+	{
+		detail::WritePlainRows(img, osas);
 	}
 }
 
-inline Image ImportImage(const std::string& src)
+//  (P3, P6  QOI)    
+template <typename ImageT = Image>
+ImageT ImportImage(const std::string& src)
 {
 	std::ifstream isus{ src, std::ios::binary };
-	std::string somethin{};
-	isus >> somethin;
+	if (!isus)
+	{
+		throw std::runtime_error("Failed to open " + src);
+	}
+
+	std::array<char, detail::QOI_MAGIC.size()> signature{};
+	if (isus.read(signature.data(), signature.size()) && signature == detail::QOI_MAGIC)
+	{
+		isus.seekg(0);
+		return DecodeQoi<ImageT>(isus);
+	}
+	isus.clear();
+	isus.seekg(0);
+
+	std::string magic{};
+	isus >> magic;
+	if (magic != "P3" && magic != "P6")
+	{
+		throw std::runtime_error("Unsupported PPM format: " + magic);
+	}
+
+	const int width = detail::ReadPpmNumber(isus);
+	const int height = detail::ReadPpmNumber(isus);
+	const int maxv = detail::ReadPpmNumber(isus);
+
+	ImageT img{ ImageSize{width, height} };
+	if (magic == "P6")
+	{
+		//  maxval    ,   
+		isus.get();
+		detail::ReadRawRows(img, isus, maxv);
+	}
+	else
+	{
+		detail::ReadPlainRows(img, isus, maxv);
+	}
 
-	int width{};
-	int height{};
-	int maxv{};
-	isus >> width >> height >> maxv;
+	return img;
+}
+
+// P6 ,   :      
+template <unsigned TileSize>
+class BasicMappedPpmSource : public IBasicTileSource<TileSize>
+{
+public:
+	using Tile = BasicTile<TileSize>;
 
-	Image img{ ImageSize{width, height} };
-	for (int y = 0; y < height; ++y)
+	explicit BasicMappedPpmSource(const std::string& src)
+		: m_path(src)
+		, m_file(src)
 	{
-		for (int x = 0; x < width; ++x)
+		//  ,     ,   ImportImage
+		const auto headerSize = std::min<size_t>(m_file.GetSize(), 1024);
+		std::istringstream isus{ std::string(reinterpret_cast<const char*>(m_file.GetData()), headerSize) };
+
+		std::string magic{};
+		isus >> magic;
+		if (magic != "P6")
+		{
+			throw std::runtime_error("Only P6 images can be mapped: " + src);
+		}
+
+		m_size.width = detail::ReadPpmNumber(isus);
+		m_size.height = detail::ReadPpmNumber(isus);
+		m_maxv = detail::ReadPpmNumber(isus);
+		isus.get();
+		if (!isus || m_maxv <= 0)
 		{
-			int r = 0;
-			int g = 0;
-			int b = 0;
+			throw std::runtime_error("Invalid PPM header: " + src);
+		}
 
-			if (!(isus >> r >> g >> b)) break;
+		m_dataOffset = static_cast<size_t>(isus.tellg());
+		m_sampleSize = m_maxv < 0x100 ? 1 : 2;
+	}
 
-			if (maxv != 0xFF && maxv > 0)
-			{
-				r = r * 0xFF / maxv;
-				g = g * 0xFF / maxv;
-				b = b * 0xFF / maxv;
-			}
+	ImageSize GetImageSize() const override
+	{
+		return m_size;
+	}
 
-			uint32_t color = (static_cast<uint32_t>(r & 0xFF) << 16)
-				| (static_cast<uint32_t>(g & 0xFF) << 8)
-				| static_cast<uint32_t>(g & 0xFF);
+	bool IsBackedBy(const std::string& path) const override
+	{
+		return detail::IsSameFile(m_path, path);
+	}
+
+	Tile LoadTile(int tileX, int tileY) const override
+	{
+		Tile tile{};
+		uint32_t row[Tile::SIZE]{};
+		const size_t pixelSize = 3 * m_sampleSize;
+
+		const int x0 = tileX * static_cast<int>(Tile::SIZE);
+		const int y0 = tileY * static_cast<int>(Tile::SIZE);
+		const unsigned width = std::min(Tile::SIZE, static_cast<unsigned>(m_size.width - x0));
+		const unsigned height = std::min(Tile::SIZE, static_cast<unsigned>(m_size.height - y0));
+
+		for (unsigned y = 0; y < height; ++y)
+		{
+			const size_t rowOffset = m_dataOffset
+				+ (static_cast<size_t>(y0 + y) * static_cast<size_t>(m_size.width) + static_cast<size_t>(x0)) * pixelSize;
+			if (rowOffset >= m_file.GetSize()) break;
 
-			img.SetPixel({ x, y }, color);
+			//  :    
+			const unsigned available = static_cast<unsigned>(std::min<size_t>(width, (m_file.GetSize() - rowOffset) / pixelSize));
+			const unsigned char* in = m_file.GetData() + rowOffset;
+			for (unsigned x = 0; x < available; ++x)
+			{
+				int rgb[3]{};
+				for (int& channel : rgb)
+				{
+					channel = m_sampleSize == 1 ? in[0] : in[0] << 8 | in[1];
+					in += m_sampleSize;
+				}
+				row[x] = detail::PackRgb(rgb[0], rgb[1], rgb[2], m_maxv);
+			}
+			tile.WriteRow({ 0, static_cast<int>(y) }, available, row);
 		}
+
+		return tile;
 	}
 
-	return img;
+private:
+	std::string m_path;
+	MappedFile m_file;
+	ImageSize m_size{};
+	int m_maxv{};
+	size_t m_dataOffset{};
+	size_t m_sampleSize{};
+};
+
+using MappedPpmSource = BasicMappedPpmSource<Tile::SIZE>;
+
+//    :       
+template <typename ImageT = Image>
+ImageT MapImage(const std::string& src)
+{
+	return ImageT{ std::make_shared<const BasicMappedPpmSource<ImageT::Tile::SIZE>>(src) };
 }
\ No newline at end of file
@@ -0,0 +1,510 @@
+#pragma once
+
+#include "Tile.h"
+#include "TiledFile.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <list>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+  ,   little-endian:
+	 -  "L9PAGES1",  ,    ,  
+	    -      ,   i 
+	              HEADER_SIZE + i * SLOT_SIZE:   SIZE * SIZE 
+   : ,    ,   ( EMPTY)
+    
+*/
+
+namespace paged
+{
+	constexpr std::array<char, 8> SIGNATURE{ 'L', '9', 'P', 'A', 'G', 'E', 'S', '1' };
+	constexpr size_t HEADER_SIZE = SIGNATURE.size() + 4 * 4;
+
+	//  
+	constexpr uint32_t EMPTY = 0;
+	constexpr uint32_t EXPANDED = 1;
+	constexpr uint32_t SOLID = 2; //    
+
+	template <unsigned TileSize>
+	constexpr size_t SLOT_SIZE = 4 + TileSize * TileSize * 4;
+
+	template <unsigned TileSize>
+	uint64_t GetSlotOffset(uint64_t tileIndex) noexcept
+	{
+		return HEADER_SIZE + tileIndex * SLOT_SIZE<TileSize>;
+	}
+} // namespace paged
+
+struct PagingStats
+{
+	uint64_t hits = 0;       //     
+	uint64_t misses = 0;     //    
+	uint64_t writeBacks = 0; //     
+};
+
+//     ,   -   
+//    (LRU).      
+//  Flush().     ,    
+//    .   
+template <unsigned TileSize>
+class BasicPagedTileStore
+{
+public:
+	using Tile = BasicTile<TileSize>;
+
+	//     
+	static constexpr size_t TILE_BYTES = sizeof(Tile) + TileSize * TileSize * sizeof(uint32_t);
+
+	//   :    color
+	BasicPagedTileStore(const std::string& path, ImageSize size, size_t memoryBudget, uint32_t color = 0)
+		: m_size(size)
+		, m_background(color)
+		, m_capacity(GetTileCapacity(memoryBudget))
+	{
+		if (size.width <= 0 || size.height <= 0)
+		{
+			throw std::out_of_range("Image size must be positive");
+		}
+
+		{
+			std::ofstream create{ path, std::ios::binary | std::ios::trunc };
+			std::array<char, paged::HEADER_SIZE> header{};
+			std::copy(paged::SIGNATURE.begin(), paged::SIGNATURE.end(), header.begin());
+			tiled::PutLittleEndian<4>(header.data() + 8, TileSize);
+			tiled::PutLittleEndian<4>(header.data() + 12, static_cast<uint32_t>(size.width));
+			tiled::PutLittleEndian<4>(header.data() + 16, static_cast<uint32_t>(size.height));
+			tiled::PutLittleEndian<4>(header.data() + 20, color);
+			if (!create.write(header.data(), header.size()))
+			{
+				throw std::runtime_error("Failed to create " + path);
+			}
+		}
+		Open(path);
+	}
+
+	//  ,   ( Flush()   )
+	BasicPagedTileStore(const std::string& path, size_t memoryBudget)
+		: m_capacity(GetTileCapacity(memoryBudget))
+	{
+		Open(path);
+
+		std::array<char, paged::HEADER_SIZE> header{};
+		if (!m_file.read(header.data(), header.size())
+			|| !std::equal(paged::SIGNATURE.begin(), paged::SIGNATURE.end(), header.begin()))
+		{
+			throw std::runtime_error("Not a paged image file: " + path);
+		}
+		if (tiled::GetLittleEndian<4>(header.data() + 8) != TileSize)
+		{
+			throw std::runtime_error("Paged image file uses another tile size");
+		}
+		m_size.width = static_cast<int>(tiled::GetLittleEndian<4>(header.data() + 12));
+		m_size.height = static_cast<int>(tiled::GetLittleEndian<4>(header.data() + 16));
+		m_background = static_cast<uint32_t>(tiled::GetLittleEndian<4>(header.data() + 20));
+		if (m_size.width <= 0 || m_size.height <= 0)
+		{
+			throw std::runtime_error("Invalid paged image size");
+		}
+	}
+
+	BasicPagedTileStore(const BasicPagedTileStore&) = delete;
+	BasicPagedTileStore& operator=(const BasicPagedTileStore&) = delete;
+
+	//   ;      ,
+	//      Flush()
+	~BasicPagedTileStore()
+	{
+		try
+		{
+			Flush();
+		}
+		catch (const std::exception&)
+		{
+		}
+	}
+
+	ImageSize GetImageSize() const noexcept
+	{
+		return m_size;
+	}
+
+	ImageSize GetTileGridSize() const noexcept
+	{
+		return {
+			(m_size.width + static_cast<int>(TileSize) - 1) / static_cast<int>(TileSize),
+			(m_size.height + static_cast<int>(TileSize) - 1) / static_cast<int>(TileSize),
+		};
+	}
+
+	//    ,    32 
+	uint64_t GetTileCount() const noexcept
+	{
+		const auto grid = GetTileGridSize();
+		return static_cast<uint64_t>(grid.width) * static_cast<uint64_t>(grid.height);
+	}
+
+	//       
+	const Tile& ReadTile(uint64_t index)
+	{
+		return GetPage(index).tile;
+	}
+
+	Tile& WriteTile(uint64_t index)
+	{
+		auto& page = GetPage(index);
+		page.dirty = true;
+		return page.tile;
+	}
+
+	//   ,      
+	void SetTile(uint64_t index, Tile tile)
+	{
+		CheckTileIndex(index);
+		if (const auto it = m_index.find(index); it != m_index.end())
+		{
+			m_pages.splice(m_pages.begin(), m_pages, it->second);
+			m_pages.front().tile = std::move(tile);
+			m_pages.front().dirty = true;
+			return;
+		}
+
+		Insert(index, std::move(tile)).dirty = true;
+	}
+
+	//    ,    
+	void Flush()
+	{
+		for (auto& page : m_pages)
+		{
+			if (page.dirty)
+			{
+				WriteBack(page);
+			}
+		}
+		if (!m_file.flush())
+		{
+			throw std::runtime_error("Failed to write paged image file");
+		}
+	}
+
+	PagingStats GetStats() const noexcept
+	{
+		return m_stats;
+	}
+
+	void ResetStats() noexcept
+	{
+		m_stats = {};
+	}
+
+	size_t GetResidentTileCount() const noexcept
+	{
+		return m_pages.size();
+	}
+
+	//      
+	size_t GetCapacity() const noexcept
+	{
+		return m_capacity;
+	}
+
+private:
+	struct Page
+	{
+		uint64_t index;
+		Tile tile;
+		bool dirty = false;
+	};
+
+	static size_t GetTileCapacity(size_t memoryBudget) noexcept
+	{
+		return std::max<size_t>(memoryBudget / TILE_BYTES, 1);
+	}
+
+	void Open(const std::string& path)
+	{
+		m_file.open(path, std::ios::binary | std::ios::in | std::ios::out);
+		if (!m_file)
+		{
+			throw std::runtime_error("Failed to open " + path);
+		}
+	}
+
+	void CheckTileIndex(uint64_t index) const
+	{
+		if (index >= GetTileCount())
+		{
+			throw std::out_of_range("Tile index is out of image");
+		}
+	}
+
+	//     ,     
+	Page& GetPage(uint64_t index)
+	{
+		CheckTileIndex(index);
+		if (const auto it = m_index.find(index); it != m_index.end())
+		{
+			++m_stats.hits;
+			m_pages.splice(m_pages.begin(), m_pages, it->second);
+			return m_pages.front();
+		}
+
+		++m_stats.misses;
+		return Insert(index, ReadSlot(index));
+	}
+
+	//     ,    
+	// ,     
+	Page& Insert(uint64_t index, Tile tile)
+	{
+		if (m_pages.size() >= m_capacity)
+		{
+			Evict();
+		}
+		m_pages.push_front({ index, std::move(tile) });
+		m_index.emplace(index, m_pages.begin());
+		return m_pages.front();
+	}
+
+	void Evict()
+	{
+		auto& victim = m_pages.back();
+		if (victim.dirty)
+		{
+			WriteBack(victim);
+		}
+		m_index.erase(victim.index);
+		m_pages.pop_back();
+	}
+
+	Tile ReadSlot(uint64_t index)
+	{
+		std::array<char, paged::SLOT_SIZE<TileSize>> bytes{};
+		m_file.seekg(static_cast<std::streamoff>(paged::GetSlotOffset<TileSize>(index)));
+		m_file.read(bytes.data(), bytes.size());
+		//       
+		const auto read = static_cast<size_t>(m_file.gcount());
+		m_file.clear();
+
+		const uint32_t mark = read >= 4 ? static_cast<uint32_t>(tiled::GetLittleEndian<4>(bytes.data())) : paged::EMPTY;
+		if (mark == paged::EMPTY)
+		{
+			return Tile{ m_background };
+		}
+		if (mark == paged::SOLID && read >= 8)
+		{
+			return Tile{ static_cast<uint32_t>(tiled::GetLittleEndian<4>(bytes.data() + 4)) };
+		}
+		if (mark != paged::EXPANDED || read != bytes.size())
+		{
+			throw std::runtime_error("Paged image file is corrupted");
+		}
+
+		Tile tile;
+		uint32_t* pixels = tile.GetMutableData();
+		for (size_t i = 0; i < TileSize * TileSize; ++i)
+		{
+			pixels[i] = static_cast<uint32_t>(tiled::GetLittleEndian<4>(bytes.data() + 4 + i * 4));
+		}
+		return tile;
+	}
+
+	void WriteBack(Page& page)
+	{
+		std::array<char, paged::SLOT_SIZE<TileSize>> bytes{};
+		size_t size = 8;
+		if (const uint32_t* pixels = page.tile.GetData())
+		{
+			tiled::PutLittleEndian<4>(bytes.data(), paged::EXPANDED);
+			for (size_t i = 0; i < TileSize * TileSize; ++i)
+			{
+				tiled::PutLittleEndian<4>(bytes.data() + 4 + i * 4, pixels[i]);
+			}
+			size = bytes.size();
+		}
+		else
+		{
+			//        
+			tiled::PutLittleEndian<4>(bytes.data(), paged::SOLID);
+			tiled::PutLittleEndian<4>(bytes.data() + 4, page.tile.GetPixel({ 0, 0 }));
+		}
+
+		m_file.seekp(static_cast<std::streamoff>(paged::GetSlotOffset<TileSize>(page.index)));
+		if (!m_file.write(bytes.data(), static_cast<std::streamsize>(size)))
+		{
+			throw std::runtime_error("Failed to write paged image file");
+		}
+		page.dirty = false;
+		++m_stats.writeBacks;
+	}
+
+	std::fstream m_file;
+	ImageSize m_size{};
+	uint32_t m_background{};
+	size_t m_capacity;
+	//    -   
+	std::list<Page> m_pages;
+	std::unordered_map<uint64_t, typename std::list<Page>::iterator> m_index;
+	PagingStats m_stats;
+};
+
+// ,     :   GetPixel/SetPixel,
+//     ,   BasicImage,  
+//     BasicPagedTileStore.    
+//  Drawer.h,   DrawBatch
+template <unsigned TileSize>
+class BasicPagedImage
+{
+public:
+	using Tile = BasicTile<TileSize>;
+	using TileStore = BasicPagedTileStore<TileSize>;
+
+	BasicPagedImage(const std::string& path, ImageSize size, size_t memoryBudget, uint32_t color = 0)
+		: m_store(path, size, memoryBudget, color)
+	{
+	}
+
+	BasicPagedImage(const std::string& path, size_t memoryBudget)
+		: m_store(path, memoryBudget)
+	{
+	}
+
+	ImageSize GetImageSize() const noexcept
+	{
+		return m_store.GetImageSize();
+	}
+
+	//   ,      const-
+	uint32_t GetPixel(Point p) const
+	{
+		if (!IsPointInImage(p, GetImageSize())) return 0;
+		return m_store.ReadTile(GetTileIndex(p))
+			.GetPixel({ p.x % static_cast<int>(TileSize), p.y % static_cast<int>(TileSize) });
+	}
+
+	void SetPixel(Point p, uint32_t color)
+	{
+		if (!IsPointInImage(p, GetImageSize())) return;
+		m_store.WriteTile(GetTileIndex(p))
+			.SetPixel({ p.x % static_cast<int>(TileSize), p.y % static_cast<int>(TileSize) }, color);
+	}
+
+	void ReadRow(int y, uint32_t* dst) const
+	{
+		CheckRow(y);
+		ForEachRowTile(y, [this, y, dst](uint64_t index, int x, unsigned count) {
+			m_store.ReadTile(index).ReadRow({ 0, y % static_cast<int>(TileSize) }, count, dst + x);
+		});
+	}
+
+	void WriteRow(int y, const uint32_t* src)
+	{
+		CheckRow(y);
+		ForEachRowTile(y, [this, y, src](uint64_t index, int x, unsigned count) {
+			m_store.WriteTile(index).WriteRow({ 0, y % static_cast<int>(TileSize) }, count, src + x);
+		});
+	}
+
+	//   BasicImage:  FillSpan  BlendPixel    Drawer.h
+	void FillSpan(int y, int x0, int x1, uint32_t color)
+	{
+		FillRect({ x0, y }, { x1, y }, color);
+	}
+
+	void BlendPixel(Point p, uint32_t color)
+	{
+		const uint32_t alpha = color >> 24;
+		if (alpha == 0 || !IsPointInImage(p, GetImageSize())) return;
+
+		auto& tile = m_store.WriteTile(GetTileIndex(p));
+		const Point local{ p.x % static_cast<int>(TileSize), p.y % static_cast<int>(TileSize) };
+		tile.SetPixel(local, alpha == 0xFF ? color : ::BlendPixel(tile.GetPixel(local), color));
+	}
+
+	//  BasicImage::FillRect:  , ,  ,
+	//      
+	void FillRect(Point from, Point to, uint32_t color)
+	{
+		const auto imageSize = GetImageSize();
+		const int left = std::max(std::min(from.x, to.x), 0);
+		const int right = std::min(std::max(from.x, to.x), imageSize.width - 1);
+		const int top = std::max(std::min(from.y, to.y), 0);
+		const int bottom = std::min(std::max(from.y, to.y), imageSize.height - 1);
+		if (left > right || top > bottom) return;
+
+		const int size = static_cast<int>(TileSize);
+		for (int tileY = top / size; tileY <= bottom / size; ++tileY)
+		{
+			const int y0 = std::max(top, tileY * size);
+			const int y1 = std::min(bottom, tileY * size + size - 1);
+			for (int tileX = left / size; tileX <= right / size; ++tileX)
+			{
+				const int x0 = std::max(left, tileX * size);
+				const int x1 = std::min(right, tileX * size + size - 1);
+				const uint64_t index = GetTileIndex({ x0, y0 });
+				if (x1 - x0 + 1 == size && y1 - y0 + 1 == size)
+				{
+					m_store.SetTile(index, Tile{ color });
+					continue;
+				}
+				m_store.WriteTile(index).FillRect({ x0 - tileX * size, y0 - tileY * size },
+					static_cast<unsigned>(x1 - x0 + 1), static_cast<unsigned>(y1 - y0 + 1), color);
+			}
+		}
+	}
+
+	void Flush()
+	{
+		m_store.Flush();
+	}
+
+	PagingStats GetStats() const noexcept
+	{
+		return m_store.GetStats();
+	}
+
+	TileStore& GetStore() noexcept
+	{
+		return m_store;
+	}
+
+private:
+	uint64_t GetTileIndex(Point p) const noexcept
+	{
+		const auto tilesX = static_cast<uint64_t>(m_store.GetTileGridSize().width);
+		return static_cast<uint64_t>(p.y / static_cast<int>(TileSize)) * tilesX
+			+ static_cast<uint64_t>(p.x / static_cast<int>(TileSize));
+	}
+
+	void CheckRow(int y) const
+	{
+		if (y < 0 || y >= GetImageSize().height)
+		{
+			throw std::out_of_range("Row is out of image");
+		}
+	}
+
+	// func( , x  ,  )    y
+	template <typename Func>
+	void ForEachRowTile(int y, Func&& func) const
+	{
+		const int width = GetImageSize().width;
+		for (int x = 0; x < width; x += static_cast<int>(TileSize))
+		{
+			func(GetTileIndex({ x, y }), x, std::min(TileSize, static_cast<unsigned>(width - x)));
+		}
+	}
+
+	//       
+	mutable TileStore m_store;
+};
+
+using PagedImage = BasicPagedImage<Tile::SIZE>;
\ No newline at end of file
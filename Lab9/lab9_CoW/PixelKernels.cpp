@@ -0,0 +1,517 @@
+﻿#include "PixelKernels.h"
+
+#include <algorithm>
+#include <atomic>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#define LAB9_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(LAB9_X86) && (defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define LAB9_SSE2 1
+#endif
+
+// gcc и clang генерируют AVX2 только в функциях, помеченных target
+#if defined(LAB9_X86) && (defined(__GNUC__) || defined(__clang__))
+#define LAB9_AVX2 1
+#define LAB9_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(LAB9_X86) && defined(_MSC_VER)
+#define LAB9_AVX2 1
+#define LAB9_TARGET_AVX2
+#endif
+
+namespace
+{
+	void FillScalar(uint32_t* dst, size_t count, uint32_t color)
+	{
+		std::fill_n(dst, count, color);
+	}
+
+	void CopyScalar(uint32_t* dst, const uint32_t* src, size_t count)
+	{
+		std::copy_n(src, count, dst);
+	}
+
+	void BlendScalar(uint32_t* dst, const uint32_t* src, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			dst[i] = BlendPixel(dst[i], src[i]);
+		}
+	}
+
+	void ReplaceScalar(uint32_t* dst, size_t count, uint32_t key, uint32_t color)
+	{
+		std::replace(dst, dst + count, key, color);
+	}
+
+	void DownsampleBoxScalar(uint32_t* dst, const uint32_t* row0, const uint32_t* row1, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			uint32_t result = 0;
+			for (int shift = 0; shift < 32; shift += 8)
+			{
+				const uint32_t sum = (row0[2 * i] >> shift & 0xFF) + (row0[2 * i + 1] >> shift & 0xFF)
+					+ (row1[2 * i] >> shift & 0xFF) + (row1[2 * i + 1] >> shift & 0xFF);
+				result |= (sum + 2) >> 2 << shift;
+			}
+			dst[i] = result;
+		}
+	}
+
+	constexpr uint32_t BILINEAR_WEIGHTS[4]{ 1, 3, 3, 1 };
+
+	void DownsampleBilinearScalar(uint32_t* dst, const uint32_t* const* rows, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			uint32_t result = 0;
+			for (int shift = 0; shift < 32; shift += 8)
+			{
+				// сумма весов 64
+				uint32_t sum = 0;
+				for (size_t y = 0; y < 4; ++y)
+				{
+					for (size_t x = 0; x < 4; ++x)
+					{
+						sum += BILINEAR_WEIGHTS[y] * BILINEAR_WEIGHTS[x] * (rows[y][2 * i + x] >> shift & 0xFF);
+					}
+				}
+				result |= (sum + 32) >> 6 << shift;
+			}
+			dst[i] = result;
+		}
+	}
+
+	// count одинаковых пикселей
+	void AddToHistogram(uint32_t* bins, uint32_t pixel, uint32_t count)
+	{
+		bins[pixel & 0xFF] += count;
+		bins[256 + (pixel >> 8 & 0xFF)] += count;
+		bins[512 + (pixel >> 16 & 0xFF)] += count;
+		bins[768 + (pixel >> 24)] += count;
+	}
+
+	void HistogramScalar(uint32_t* bins, const uint32_t* src, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			AddToHistogram(bins, src[i], 1);
+		}
+	}
+
+	constexpr PixelKernels SCALAR_KERNELS{ SimdLevel::Scalar, FillScalar, CopyScalar, BlendScalar, ReplaceScalar,
+		DownsampleBoxScalar, DownsampleBilinearScalar, HistogramScalar };
+
+#ifdef LAB9_SSE2
+	void FillSse2(uint32_t* dst, size_t count, uint32_t color)
+	{
+		const __m128i value = _mm_set1_epi32(static_cast<int>(color));
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), value);
+		}
+		FillScalar(dst + i, count - i, color);
+	}
+
+	void CopySse2(uint32_t* dst, const uint32_t* src, size_t count)
+	{
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+		}
+		CopyScalar(dst + i, src + i, count - i);
+	}
+
+	// два пикселя в 16-битных каналах: те же вычисления, что в BlendPixel
+	__m128i BlendHalfSse2(__m128i dst, __m128i src)
+	{
+		const __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(src, 0xFF), 0xFF);
+		const __m128i source = _mm_or_si128(src, _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0));
+		const __m128i inverse = _mm_sub_epi16(_mm_set1_epi16(255), alpha);
+
+		__m128i value = _mm_add_epi16(_mm_mullo_epi16(source, alpha), _mm_mullo_epi16(dst, inverse));
+		value = _mm_add_epi16(value, _mm_set1_epi16(128));
+		return _mm_srli_epi16(_mm_add_epi16(value, _mm_srli_epi16(value, 8)), 8);
+	}
+
+	void BlendSse2(uint32_t* dst, const uint32_t* src, size_t count)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+			const __m128i lo = BlendHalfSse2(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero));
+			const __m128i hi = BlendHalfSse2(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+		}
+		BlendScalar(dst + i, src + i, count - i);
+	}
+
+	void ReplaceSse2(uint32_t* dst, size_t count, uint32_t key, uint32_t color)
+	{
+		const __m128i keys = _mm_set1_epi32(static_cast<int>(key));
+		const __m128i colors = _mm_set1_epi32(static_cast<int>(color));
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			auto* p = reinterpret_cast<__m128i*>(dst + i);
+			const __m128i value = _mm_loadu_si128(p);
+			const __m128i mask = _mm_cmpeq_epi32(value, keys);
+			_mm_storeu_si128(p, _mm_or_si128(_mm_and_si128(mask, colors), _mm_andnot_si128(mask, value)));
+		}
+		ReplaceScalar(dst + i, count - i, key, color);
+	}
+
+	// к lo и hi добавляются суммы пикселей 2i и 2i + 1 для i = 0..3 в 16-битных каналах:
+	// в lo - для i = 0, 1, в hi - для i = 2, 3
+	void AddPixelPairsSse2(const uint32_t* src, __m128i& lo, __m128i& hi)
+	{
+		const __m128 a = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+		const __m128 b = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4)));
+		const __m128i even = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+		const __m128i odd = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+		const __m128i zero = _mm_setzero_si128();
+		lo = _mm_add_epi16(lo, _mm_add_epi16(_mm_unpacklo_epi8(even, zero), _mm_unpacklo_epi8(odd, zero)));
+		hi = _mm_add_epi16(hi, _mm_add_epi16(_mm_unpackhi_epi8(even, zero), _mm_unpackhi_epi8(odd, zero)));
+	}
+
+	void DownsampleBoxSse2(uint32_t* dst, const uint32_t* row0, const uint32_t* row1, size_t count)
+	{
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128i lo = _mm_set1_epi16(2);
+			__m128i hi = lo;
+			AddPixelPairsSse2(row0 + 2 * i, lo, hi);
+			AddPixelPairsSse2(row1 + 2 * i, lo, hi);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+				_mm_packus_epi16(_mm_srli_epi16(lo, 2), _mm_srli_epi16(hi, 2)));
+		}
+		DownsampleBoxScalar(dst + i, row0 + 2 * i, row1 + 2 * i, count - i);
+	}
+
+	// a + 3 (b + c) + d в 16-битных каналах
+	__m128i WeighBilinearSse2(__m128i a, __m128i b, __m128i c, __m128i d)
+	{
+		const __m128i inner = _mm_add_epi16(b, c);
+		return _mm_add_epi16(_mm_add_epi16(a, d), _mm_add_epi16(inner, _mm_add_epi16(inner, inner)));
+	}
+
+	// сначала взвешиваются строки, затем столбцы; в каждом регистре два соседних
+	// столбца в 16-битных каналах, суммы не превышают 64 * 255
+	void DownsampleBilinearSse2(uint32_t* dst, const uint32_t* const* rows, size_t count)
+	{
+		constexpr size_t CHUNK = 32;
+		const __m128i zero = _mm_setzero_si128();
+		__m128i columns[CHUNK + 1];
+
+		size_t i = 0;
+		while (i + 2 <= count)
+		{
+			const size_t chunk = std::min(CHUNK, (count - i) & ~size_t{ 1 });
+			for (size_t k = 0; k <= chunk; ++k)
+			{
+				__m128i pairs[4];
+				for (size_t y = 0; y < 4; ++y)
+				{
+					pairs[y] = _mm_unpacklo_epi8(
+						_mm_loadl_epi64(reinterpret_cast<const __m128i*>(rows[y] + 2 * (i + k))), zero);
+				}
+				columns[k] = WeighBilinearSse2(pairs[0], pairs[1], pairs[2], pairs[3]);
+			}
+
+			// результаты i + k и i + k + 1 берут столбцы из регистров k, k + 1 и k + 2
+			for (size_t k = 0; k < chunk; k += 2)
+			{
+				__m128i value = WeighBilinearSse2(
+					_mm_unpacklo_epi64(columns[k], columns[k + 1]),
+					_mm_unpackhi_epi64(columns[k], columns[k + 1]),
+					_mm_unpacklo_epi64(columns[k + 1], columns[k + 2]),
+					_mm_unpackhi_epi64(columns[k + 1], columns[k + 2]));
+				value = _mm_srli_epi16(_mm_add_epi16(value, _mm_set1_epi16(32)), 6);
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i + k), _mm_packus_epi16(value, zero));
+			}
+			i += chunk;
+		}
+
+		const uint32_t* tail[4]{ rows[0] + 2 * i, rows[1] + 2 * i, rows[2] + 2 * i, rows[3] + 2 * i };
+		DownsampleBilinearScalar(dst + i, tail, count - i);
+	}
+
+	// четвёрка одинаковых пикселей (заливка) находится одним сравнением
+	// и добавляется за раз, остальные пиксели раскладываются по одному
+	void HistogramSse2(uint32_t* bins, const uint32_t* src, size_t count)
+	{
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			if (_mm_movemask_epi8(_mm_cmpeq_epi32(value, _mm_set1_epi32(static_cast<int>(src[i])))) == 0xFFFF)
+			{
+				AddToHistogram(bins, src[i], 4);
+			}
+			else
+			{
+				for (size_t k = i; k < i + 4; ++k)
+				{
+					AddToHistogram(bins, src[k], 1);
+				}
+			}
+		}
+		HistogramScalar(bins, src + i, count - i);
+	}
+
+	constexpr PixelKernels SSE2_KERNELS{ SimdLevel::Sse2, FillSse2, CopySse2, BlendSse2, ReplaceSse2,
+		DownsampleBoxSse2, DownsampleBilinearSse2, HistogramSse2 };
+#endif
+
+#ifdef LAB9_AVX2
+	LAB9_TARGET_AVX2 void FillAvx2(uint32_t* dst, size_t count, uint32_t color)
+	{
+		const __m256i value = _mm256_set1_epi32(static_cast<int>(color));
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), value);
+		}
+		FillScalar(dst + i, count - i, color);
+	}
+
+	LAB9_TARGET_AVX2 void CopyAvx2(uint32_t* dst, const uint32_t* src, size_t count)
+	{
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i),
+				_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i)));
+		}
+		CopyScalar(dst + i, src + i, count - i);
+	}
+
+	LAB9_TARGET_AVX2 __m256i BlendHalfAvx2(__m256i dst, __m256i src)
+	{
+		const __m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(src, 0xFF), 0xFF);
+		const __m256i source = _mm256_or_si256(src,
+			_mm256_set_epi16(255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0));
+		const __m256i inverse = _mm256_sub_epi16(_mm256_set1_epi16(255), alpha);
+
+		__m256i value = _mm256_add_epi16(_mm256_mullo_epi16(source, alpha), _mm256_mullo_epi16(dst, inverse));
+		value = _mm256_add_epi16(value, _mm256_set1_epi16(128));
+		return _mm256_srli_epi16(_mm256_add_epi16(value, _mm256_srli_epi16(value, 8)), 8);
+	}
+
+	LAB9_TARGET_AVX2 void BlendAvx2(uint32_t* dst, const uint32_t* src, size_t count)
+	{
+		const __m256i zero = _mm256_setzero_si256();
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+			const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+			// unpack и pack работают внутри 128-битных половин, порядок пикселей сохраняется
+			const __m256i lo = BlendHalfAvx2(_mm256_unpacklo_epi8(d, zero), _mm256_unpacklo_epi8(s, zero));
+			const __m256i hi = BlendHalfAvx2(_mm256_unpackhi_epi8(d, zero), _mm256_unpackhi_epi8(s, zero));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_packus_epi16(lo, hi));
+		}
+		BlendScalar(dst + i, src + i, count - i);
+	}
+
+	LAB9_TARGET_AVX2 void ReplaceAvx2(uint32_t* dst, size_t count, uint32_t key, uint32_t color)
+	{
+		const __m256i keys = _mm256_set1_epi32(static_cast<int>(key));
+		const __m256i colors = _mm256_set1_epi32(static_cast<int>(color));
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			auto* p = reinterpret_cast<__m256i*>(dst + i);
+			const __m256i value = _mm256_loadu_si256(p);
+			_mm256_storeu_si256(p, _mm256_blendv_epi8(value, colors, _mm256_cmpeq_epi32(value, keys)));
+		}
+		ReplaceScalar(dst + i, count - i, key, color);
+	}
+
+	LAB9_TARGET_AVX2 void AddPixelPairsAvx2(const uint32_t* src, __m256i& lo, __m256i& hi)
+	{
+		const __m256 a = _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src)));
+		const __m256 b = _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 8)));
+		const __m256i even = _mm256_castps_si256(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+		const __m256i odd = _mm256_castps_si256(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+		const __m256i zero = _mm256_setzero_si256();
+		lo = _mm256_add_epi16(lo, _mm256_add_epi16(_mm256_unpacklo_epi8(even, zero), _mm256_unpacklo_epi8(odd, zero)));
+		hi = _mm256_add_epi16(hi, _mm256_add_epi16(_mm256_unpackhi_epi8(even, zero), _mm256_unpackhi_epi8(odd, zero)));
+	}
+
+	LAB9_TARGET_AVX2 void DownsampleBoxAvx2(uint32_t* dst, const uint32_t* row0, const uint32_t* row1, size_t count)
+	{
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256i lo = _mm256_set1_epi16(2);
+			__m256i hi = lo;
+			AddPixelPairsAvx2(row0 + 2 * i, lo, hi);
+			AddPixelPairsAvx2(row1 + 2 * i, lo, hi);
+			// shuffle работает внутри 128-битных половин: результаты лежат
+			// в порядке 0 1 4 5 2 3 6 7, перестановка 64-битных частей его восстанавливает
+			const __m256i packed = _mm256_packus_epi16(_mm256_srli_epi16(lo, 2), _mm256_srli_epi16(hi, 2));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0)));
+		}
+		DownsampleBoxScalar(dst + i, row0 + 2 * i, row1 + 2 * i, count - i);
+	}
+
+	// четыре столбца, начиная с x, взвешенные по строкам 1 3 3 1, в 16-битных каналах
+	LAB9_TARGET_AVX2 __m256i WeighColumnsAvx2(const uint32_t* const* rows, size_t x)
+	{
+		__m256i value[4];
+		for (size_t y = 0; y < 4; ++y)
+		{
+			value[y] = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[y] + x)));
+		}
+		const __m256i inner = _mm256_add_epi16(value[1], value[2]);
+		return _mm256_add_epi16(_mm256_add_epi16(value[0], value[3]), _mm256_add_epi16(inner, _mm256_add_epi16(inner, inner)));
+	}
+
+	LAB9_TARGET_AVX2 void DownsampleBilinearAvx2(uint32_t* dst, const uint32_t* const* rows, size_t count)
+	{
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			// результату k нужны столбцы 2k..2k + 3: первые два слагаемых берутся
+			// из столбцов 0..7, последние два - из столбцов 2..9
+			const __m256i near0 = WeighColumnsAvx2(rows, 2 * i);
+			const __m256i near1 = WeighColumnsAvx2(rows, 2 * i + 4);
+			const __m256i far0 = WeighColumnsAvx2(rows, 2 * i + 2);
+			const __m256i far1 = WeighColumnsAvx2(rows, 2 * i + 6);
+			constexpr int ORDER = _MM_SHUFFLE(3, 1, 2, 0);
+			const __m256i a = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(near0, near1), ORDER);
+			const __m256i b = _mm256_permute4x64_epi64(_mm256_unpackhi_epi64(near0, near1), ORDER);
+			const __m256i c = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(far0, far1), ORDER);
+			const __m256i d = _mm256_permute4x64_epi64(_mm256_unpackhi_epi64(far0, far1), ORDER);
+
+			const __m256i inner = _mm256_add_epi16(b, c);
+			__m256i value = _mm256_add_epi16(_mm256_add_epi16(a, d), _mm256_add_epi16(inner, _mm256_add_epi16(inner, inner)));
+			value = _mm256_srli_epi16(_mm256_add_epi16(value, _mm256_set1_epi16(32)), 6);
+			const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(value, _mm256_setzero_si256()), ORDER);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm256_castsi256_si128(packed));
+		}
+
+		const uint32_t* tail[4]{ rows[0] + 2 * i, rows[1] + 2 * i, rows[2] + 2 * i, rows[3] + 2 * i };
+		DownsampleBilinearScalar(dst + i, tail, count - i);
+	}
+
+	LAB9_TARGET_AVX2 void HistogramAvx2(uint32_t* bins, const uint32_t* src, size_t count)
+	{
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+			if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(value, _mm256_set1_epi32(static_cast<int>(src[i])))) == -1)
+			{
+				AddToHistogram(bins, src[i], 8);
+			}
+			else
+			{
+				for (size_t k = i; k < i + 8; ++k)
+				{
+					AddToHistogram(bins, src[k], 1);
+				}
+			}
+		}
+		// gcc не всегда сбрасывает старшие половины регистров сам, а без этого
+		// следующий SSE-код вызывающего замедляется
+		_mm256_zeroupper();
+		HistogramScalar(bins, src + i, count - i);
+	}
+
+	constexpr PixelKernels AVX2_KERNELS{ SimdLevel::Avx2, FillAvx2, CopyAvx2, BlendAvx2, ReplaceAvx2,
+		DownsampleBoxAvx2, DownsampleBilinearAvx2, HistogramAvx2 };
+
+	bool HasAvx2() noexcept
+	{
+#ifdef _MSC_VER
+		int info[4]{};
+		__cpuid(info, 0);
+		if (info[0] < 7) return false;
+
+		__cpuid(info, 1);
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+		// ОС должна сохранять регистры YMM
+		if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) return false;
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+#endif
+
+	SimdLevel DetectSimdLevel() noexcept
+	{
+#ifdef LAB9_AVX2
+		if (HasAvx2())
+		{
+			return SimdLevel::Avx2;
+		}
+#endif
+#ifdef LAB9_SSE2
+		return SimdLevel::Sse2;
+#else
+		return SimdLevel::Scalar;
+#endif
+	}
+
+	std::atomic<const PixelKernels*> g_activeKernels{ nullptr };
+
+} // namespace
+
+SimdLevel GetSupportedSimdLevel() noexcept
+{
+	static const SimdLevel level = DetectSimdLevel();
+	return level;
+}
+
+const PixelKernels& GetPixelKernels(SimdLevel level) noexcept
+{
+	level = std::min(level, GetSupportedSimdLevel());
+#ifdef LAB9_AVX2
+	if (level == SimdLevel::Avx2)
+	{
+		return AVX2_KERNELS;
+	}
+#endif
+#ifdef LAB9_SSE2
+	if (level >= SimdLevel::Sse2)
+	{
+		return SSE2_KERNELS;
+	}
+#endif
+	return SCALAR_KERNELS;
+}
+
+const PixelKernels& GetPixelKernels() noexcept
+{
+	const PixelKernels* kernels = g_activeKernels.load(std::memory_order_acquire);
+	if (!kernels)
+	{
+		kernels = &GetPixelKernels(GetSupportedSimdLevel());
+		g_activeKernels.store(kernels, std::memory_order_release);
+	}
+	return *kernels;
+}
+
+void UsePixelKernels(SimdLevel level) noexcept
+{
+	g_activeKernels.store(&GetPixelKernels(level), std::memory_order_release);
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+//       ARGB (0xAARRGGBB);
+//        
+
+enum class SimdLevel
+{
+	Scalar,
+	Sse2,
+	Avx2,
+};
+
+struct PixelKernels
+{
+	SimdLevel level;
+	void (*fill)(uint32_t* dst, size_t count, uint32_t color);
+	void (*copy)(uint32_t* dst, const uint32_t* src, size_t count);
+	// source-over   ARGB:
+	// dst = (src * a + dst * (255 - a)) / 255  ,    
+	void (*blend)(uint32_t* dst, const uint32_t* src, size_t count);
+	//   ,  key,  color
+	void (*replace)(uint32_t* dst, size_t count, uint32_t key, uint32_t color);
+	//  : dst[i] -   2i  2i + 1  row0  row1,
+	//   
+	void (*downsampleBox)(uint32_t* dst, const uint32_t* row0, const uint32_t* row1, size_t count);
+	//      1 3 3 1   : dst[i] 
+	//   2i..2i + 3   rows
+	void (*downsampleBilinear)(uint32_t* dst, const uint32_t* const* rows, size_t count);
+	//  src   : bins - 4   256 ,
+	//     (, , , )
+	void (*histogram)(uint32_t* bins, const uint32_t* src, size_t count);
+};
+
+SimdLevel GetSupportedSimdLevel() noexcept;
+
+//     (     -   )
+const PixelKernels& GetPixelKernels(SimdLevel level) noexcept;
+
+// ,   Tile  Image;   -   
+const PixelKernels& GetPixelKernels() noexcept;
+void UsePixelKernels(SimdLevel level) noexcept;
+
+//   ,     
+inline uint32_t BlendPixel(uint32_t dst, uint32_t src) noexcept
+{
+	const uint32_t alpha = src >> 24;
+	const uint32_t source = src | 0xFF000000u;
+	uint32_t result = 0;
+	for (int shift = 0; shift < 32; shift += 8)
+	{
+		uint32_t value = (source >> shift & 0xFF) * alpha + (dst >> shift & 0xFF) * (255 - alpha) + 128;
+		value = (value + (value >> 8)) >> 8;
+		result |= value << shift;
+	}
+	return result;
+}
\ No newline at end of file
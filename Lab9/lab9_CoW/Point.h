@@ -12,6 +12,13 @@ struct ImageSize
 	int height{};
 };
 
+// :     
+struct Rect
+{
+	Point origin;
+	ImageSize size;
+};
+
 inline bool IsPointInImage(Point p, ImageSize sz)
 {
 	return p.x >= 0
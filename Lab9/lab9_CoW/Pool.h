@@ -0,0 +1,135 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+//    :    (slab)  
+//      ,    
+class FixedBlockPool
+{
+public:
+	FixedBlockPool(size_t blockSize, size_t alignment, size_t blocksPerSlab = 256)
+		: m_blockSize(RoundUp(std::max(blockSize, sizeof(FreeBlock)), std::max(alignment, alignof(FreeBlock))))
+		, m_alignment(std::max(alignment, alignof(FreeBlock)))
+		, m_blocksPerSlab(blocksPerSlab)
+	{
+	}
+
+	FixedBlockPool(const FixedBlockPool&) = delete;
+	FixedBlockPool& operator=(const FixedBlockPool&) = delete;
+
+	~FixedBlockPool()
+	{
+		for (void* slab : m_slabs)
+		{
+			::operator delete(slab, std::align_val_t{ m_alignment });
+		}
+	}
+
+	void* Allocate()
+	{
+		std::lock_guard lock{ m_mutex };
+		if (!m_free)
+		{
+			AddSlab();
+		}
+
+		FreeBlock* block = m_free;
+		m_free = block->next;
+		return block;
+	}
+
+	void Deallocate(void* p) noexcept
+	{
+		std::lock_guard lock{ m_mutex };
+		auto* block = static_cast<FreeBlock*>(p);
+		block->next = m_free;
+		m_free = block;
+	}
+
+private:
+	struct FreeBlock
+	{
+		FreeBlock* next;
+	};
+
+	static size_t RoundUp(size_t value, size_t alignment) noexcept
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	void AddSlab()
+	{
+		auto* slab = static_cast<std::byte*>(
+			::operator new(m_blockSize * m_blocksPerSlab, std::align_val_t{ m_alignment }));
+		m_slabs.push_back(slab);
+
+		for (size_t i = m_blocksPerSlab; i-- > 0;)
+		{
+			auto* block = reinterpret_cast<FreeBlock*>(slab + i * m_blockSize);
+			block->next = m_free;
+			m_free = block;
+		}
+	}
+
+	const size_t m_blockSize;
+	const size_t m_alignment;
+	const size_t m_blocksPerSlab;
+	std::mutex m_mutex;
+	FreeBlock* m_free = nullptr;
+	std::vector<void*> m_slabs;
+};
+
+//   std::allocate_shared:   ,   
+//  shared_ptr (  + ),  
+template <typename T>
+class PoolAllocator
+{
+public:
+	using value_type = T;
+
+	PoolAllocator() noexcept = default;
+
+	template <typename U>
+	PoolAllocator(const PoolAllocator<U>&) noexcept {}
+
+	T* allocate(size_t n)
+	{
+		if (n != 1)
+		{
+			return std::allocator<T>{}.allocate(n);
+		}
+		return static_cast<T*>(GetPool().Allocate());
+	}
+
+	void deallocate(T* p, size_t n) noexcept
+	{
+		if (n != 1)
+		{
+			std::allocator<T>{}.deallocate(p, n);
+			return;
+		}
+		GetPool().Deallocate(p);
+	}
+
+	template <typename U>
+	bool operator==(const PoolAllocator<U>&) const noexcept
+	{
+		return true;
+	}
+
+private:
+	static FixedBlockPool& GetPool()
+	{
+		//   : shared_ptr   
+		//        main.
+		//   (  )   
+		static auto* pool = new FixedBlockPool{ sizeof(T), alignof(T),
+			std::clamp<size_t>(64 * 1024 / sizeof(T), 1, 256) };
+		return *pool;
+	}
+};
\ No newline at end of file
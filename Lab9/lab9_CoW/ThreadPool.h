@@ -0,0 +1,147 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//         
+class ThreadPool
+{
+public:
+	explicit ThreadPool(unsigned threadCount = std::max(1u, std::thread::hardware_concurrency()))
+	{
+		//      ParallelFor,     
+		for (unsigned i = 1; i < threadCount; ++i)
+		{
+			m_threads.emplace_back([this] { Run(); });
+		}
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard lock{ m_mutex };
+			m_stop = true;
+		}
+		m_hasTasks.notify_all();
+		for (auto& thread : m_threads)
+		{
+			thread.join();
+		}
+	}
+
+	unsigned GetThreadCount() const noexcept
+	{
+		return static_cast<unsigned>(m_threads.size()) + 1;
+	}
+
+	//  func(i)   i  [0; count)    
+	//   ;    
+	template <typename Func>
+	void ParallelFor(size_t count, Func&& func)
+	{
+		if (count == 0) return;
+
+		auto state = std::make_shared<ForState>();
+		auto body = [&func, count, state] {
+			for (size_t i = state->next++; i < count; i = state->next++)
+			{
+				try
+				{
+					func(i);
+				}
+				catch (...)
+				{
+					std::lock_guard lock{ state->mutex };
+					if (!state->error)
+					{
+						state->error = std::current_exception();
+					}
+					state->next = count;
+				}
+			}
+		};
+
+		const size_t helpers = std::min(count - 1, m_threads.size());
+		{
+			std::lock_guard lock{ m_mutex };
+			for (size_t i = 0; i < helpers; ++i)
+			{
+				// ,       ParallelFor,   
+				m_tasks.emplace_back([body, state] {
+					{
+						std::lock_guard lock{ state->mutex };
+						if (state->closed) return;
+						++state->running;
+					}
+					body();
+					std::lock_guard lock{ state->mutex };
+					--state->running;
+					state->done.notify_all();
+				});
+			}
+		}
+		m_hasTasks.notify_all();
+
+		body();
+
+		std::unique_lock lock{ state->mutex };
+		state->closed = true;
+		state->done.wait(lock, [&state] { return state->running == 0; });
+		if (state->error)
+		{
+			std::rethrow_exception(state->error);
+		}
+	}
+
+private:
+	struct ForState
+	{
+		std::atomic<size_t> next{ 0 };
+		std::mutex mutex;
+		std::condition_variable done;
+		size_t running = 0;
+		bool closed = false;
+		std::exception_ptr error;
+	};
+
+	void Run()
+	{
+		for (;;)
+		{
+			std::function<void()> task;
+			{
+				std::unique_lock lock{ m_mutex };
+				m_hasTasks.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+				if (m_tasks.empty()) return;
+
+				task = std::move(m_tasks.front());
+				m_tasks.pop_front();
+			}
+			task();
+		}
+	}
+
+	std::vector<std::thread> m_threads;
+	std::mutex m_mutex;
+	std::condition_variable m_hasTasks;
+	std::deque<std::function<void()>> m_tasks;
+	bool m_stop = false;
+};
+
+//       ,    
+inline ThreadPool& GetDefaultThreadPool()
+{
+	static ThreadPool pool;
+	return pool;
+}
\ No newline at end of file
@@ -1,46 +1,197 @@
 #pragma once
 
+#include "CoW.h"
+#include "PixelKernels.h"
 #include "Point.h"
+#include "Pool.h"
 
-#include <vector>
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
 #include <cstdint>
+#include <new>
+#include <utility>
 
-class Tile
+//     ,   
+//          TryCollapse().
+// Size -    
+template <unsigned Size>
+class BasicTile
 {
 public:
-	static constexpr unsigned SIZE = 8;
+	static_assert(Size > 0, "Tile must not be empty");
 
-	Tile(uint32_t color = 0) noexcept
-		: m_pixels(SIZE* SIZE, color)
+	static constexpr unsigned SIZE = Size;
+
+	// CoW<BasicTile>      
+	using allocator_type = PoolAllocator<BasicTile>;
+
+	BasicTile(uint32_t color = 0) noexcept
+		: m_color(color)
 	{
 		assert(m_instanceCount >= 0);
-		++m_instanceCount;
+		CountInstance();
 	}
 
-	Tile(const Tile& oth)
-		: m_pixels(oth.m_pixels)
+	BasicTile(const BasicTile& oth)
+		: m_color(oth.m_color)
+		, m_pixels(oth.m_pixels ? AllocatePixels(*oth.m_pixels) : nullptr)
 	{
 		assert(m_instanceCount >= 0);
-		++m_instanceCount;
+		CountInstance();
+	}
+
+	BasicTile(BasicTile&& oth) noexcept
+		: m_color(oth.m_color)
+		, m_pixels(std::exchange(oth.m_pixels, nullptr))
+	{
+		assert(m_instanceCount >= 0);
+		CountInstance();
+	}
+
+	BasicTile& operator=(BasicTile oth) noexcept
+	{
+		std::swap(m_color, oth.m_color);
+		std::swap(m_pixels, oth.m_pixels);
+		return *this;
 	}
 
-	~Tile() noexcept
+	~BasicTile() noexcept
 	{
+		ReleasePixels();
 		--m_instanceCount;
 		assert(m_instanceCount >= 0);
 	}
 
-	void SetPixel(Point p, uint32_t color) noexcept
+	void SetPixel(Point p, uint32_t color)
 	{
 		if (!IsPointInImage(p, { SIZE, SIZE })) return;
-		m_pixels[p.y * SIZE + p.x] = color;
+		if (!m_pixels && color == m_color) return;
+
+		Expand()[p.y * SIZE + p.x] = color;
 	}
 
 	uint32_t GetPixel(Point p) const noexcept
 	{
 		if (!IsPointInImage(p, { SIZE, SIZE })) return 0;
-		return m_pixels[p.y * SIZE + p.x];
+		return m_pixels ? (*m_pixels)[p.y * SIZE + p.x] : m_color;
+	}
+
+	//  count   ,    from
+	void ReadRow(Point from, unsigned count, uint32_t* dst) const noexcept
+	{
+		assert(IsPointInImage(from, { SIZE, SIZE }) && from.x + count <= SIZE);
+		if (!m_pixels)
+		{
+			std::fill_n(dst, count, m_color);
+			return;
+		}
+
+		const auto begin = m_pixels->begin() + from.y * SIZE + from.x;
+		std::copy(begin, begin + count, dst);
+	}
+
+	void WriteRow(Point from, unsigned count, const uint32_t* src)
+	{
+		assert(IsPointInImage(from, { SIZE, SIZE }) && from.x + count <= SIZE);
+		if (!m_pixels && std::all_of(src, src + count, [this](uint32_t c) { return c == m_color; })) return;
+
+		std::copy(src, src + count, Expand().begin() + from.y * SIZE + from.x);
+	}
+
+	void FillRect(Point from, unsigned width, unsigned height, uint32_t color)
+	{
+		assert(IsPointInImage(from, { SIZE, SIZE }) && from.x + width <= SIZE && from.y + height <= SIZE);
+		if (width == SIZE && height == SIZE)
+		{
+			ReleasePixels();
+			m_color = color;
+			return;
+		}
+		if (!m_pixels && color == m_color) return;
+
+		auto& pixels = Expand();
+		if (width == SIZE)
+		{
+			//    
+			GetPixelKernels().fill(pixels.data() + from.y * SIZE, SIZE * height, color);
+			return;
+		}
+
+		for (unsigned y = 0; y < height; ++y)
+		{
+			const auto begin = pixels.begin() + (from.y + y) * SIZE + from.x;
+			std::fill(begin, begin + width, color);
+		}
+	}
+
+	//   , SIZE * SIZE ;    - nullptr
+	const uint32_t* GetData() const noexcept
+	{
+		return m_pixels ? m_pixels->data() : nullptr;
+	}
+
+	//   
+	uint32_t* GetMutableData()
+	{
+		return Expand().data();
+	}
+
+	bool IsSolid() const noexcept
+	{
+		return !m_pixels;
+	}
+
+	// true,       (  )
+	bool IsUniform() const noexcept
+	{
+		return !m_pixels || std::all_of(m_pixels->begin(), m_pixels->end(),
+			[first = m_pixels->front()](uint32_t c) { return c == first; });
+	}
+
+	//       
+	bool TryCollapse() noexcept
+	{
+		if (!m_pixels || !IsUniform()) return false;
+
+		m_color = m_pixels->front();
+		ReleasePixels();
+		return true;
+	}
+
+	//     :       
+	size_t GetContentHash() const noexcept
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (unsigned i = 0; i < SIZE * SIZE; ++i)
+		{
+			hash = (hash ^ (m_pixels ? (*m_pixels)[i] : m_color)) * 1099511628211ull;
+		}
+		return static_cast<size_t>(hash);
+	}
+
+	bool operator==(const BasicTile& oth) const noexcept
+	{
+		if (!m_pixels && !oth.m_pixels)
+		{
+			return m_color == oth.m_color;
+		}
+		if (m_pixels && oth.m_pixels)
+		{
+			return *m_pixels == *oth.m_pixels;
+		}
+
+		const BasicTile& solid = m_pixels ? oth : *this;
+		const BasicTile& expanded = m_pixels ? *this : oth;
+		return std::all_of(expanded.m_pixels->begin(), expanded.m_pixels->end(),
+			[color = solid.m_color](uint32_t c) { return c == color; });
+	}
+
+	// ,    
+	size_t GetByteSize() const noexcept
+	{
+		return sizeof(BasicTile) + (m_pixels ? sizeof(Pixels) : 0);
 	}
 
 	static int GetInstanceCount() noexcept
@@ -48,7 +199,64 @@ public:
 		return m_instanceCount;
 	}
 
+	//       ResetPeakInstanceCount(),
+	//   CoWCounters
+	static int GetPeakInstanceCount() noexcept
+	{
+		return m_peakInstanceCount;
+	}
+
+	static void ResetPeakInstanceCount() noexcept
+	{
+		m_peakInstanceCount = m_instanceCount.load();
+	}
+
 private:
-	inline static int m_instanceCount{};
-	std::vector<uint32_t> m_pixels{};
-};
\ No newline at end of file
+	using Pixels = std::array<uint32_t, SIZE * SIZE>;
+	using PixelsAllocator = PoolAllocator<Pixels>;
+
+	static void CountInstance() noexcept
+	{
+		const int count = ++m_instanceCount;
+		if (!CoWCounters::IsEnabled()) return;
+
+		int peak = m_peakInstanceCount.load(std::memory_order_relaxed);
+		while (count > peak && !m_peakInstanceCount.compare_exchange_weak(peak, count, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	static Pixels* AllocatePixels(const Pixels& pixels)
+	{
+		return new (PixelsAllocator{}.allocate(1)) Pixels(pixels);
+	}
+
+	Pixels& Expand()
+	{
+		if (!m_pixels)
+		{
+			m_pixels = new (PixelsAllocator{}.allocate(1)) Pixels;
+			GetPixelKernels().fill(m_pixels->data(), m_pixels->size(), m_color);
+		}
+		return *m_pixels;
+	}
+
+	void ReleasePixels() noexcept
+	{
+		if (m_pixels)
+		{
+			PixelsAllocator{}.deallocate(m_pixels, 1);
+			m_pixels = nullptr;
+		}
+	}
+
+	//      
+	inline static std::atomic<int> m_instanceCount{};
+	inline static std::atomic<int> m_peakInstanceCount{};
+	uint32_t m_color{};
+	//       :    
+	// ,         (BM_Unshare*Tile)
+	Pixels* m_pixels = nullptr;
+};
+
+using Tile = BasicTile<8>;
\ No newline at end of file
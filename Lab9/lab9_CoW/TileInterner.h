@@ -0,0 +1,72 @@
+#pragma once
+
+#include "CoW.h"
+#include "Tile.h"
+
+#include <unordered_map>
+#include <vector>
+
+//    :    
+//     CoW<Tile>
+template <unsigned TileSize>
+class BasicTileInterner
+{
+public:
+	using Tile = BasicTile<TileSize>;
+
+	//  tile         ;
+	//   ,  .    :
+	//        
+	size_t Intern(CoW<Tile>& tile)
+	{
+		auto& bucket = m_tiles[tile->GetContentHash()];
+		m_size -= std::erase_if(bucket, [](const Entry& entry) { return entry.IsExpired(); });
+		for (const auto& entry : bucket)
+		{
+			auto known = entry.Lock();
+			if (!known) continue;
+			if (known->IsSharedWith(tile)) return 0;
+			//        Intern,   
+			if (**known != *tile) continue;
+
+			//   ,       
+			const size_t reclaimed = tile.GetInstanceCount() == 1 ? tile->GetByteSize() : 0;
+			tile = *known;
+			return reclaimed;
+		}
+
+		bucket.push_back(tile.GetWeak());
+		++m_size;
+		return 0;
+	}
+
+	//   .       
+	void Prune()
+	{
+		for (auto it = m_tiles.begin(); it != m_tiles.end();)
+		{
+			auto& bucket = it->second;
+			m_size -= std::erase_if(bucket, [](const Entry& entry) { return entry.IsExpired(); });
+			it = bucket.empty() ? m_tiles.erase(it) : std::next(it);
+		}
+	}
+
+	void Clear() noexcept
+	{
+		m_tiles.clear();
+		m_size = 0;
+	}
+
+	size_t GetSize() const noexcept
+	{
+		return m_size;
+	}
+
+private:
+	using Entry = typename CoW<Tile>::Weak;
+
+	std::unordered_map<size_t, std::vector<Entry>> m_tiles;
+	size_t m_size = 0;
+};
+
+using TileInterner = BasicTileInterner<Tile::SIZE>;
\ No newline at end of file
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "CoW.h"
+#include "Tile.h"
+
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+//     ,   :
+//          
+template <unsigned TileSize>
+class IBasicTileSource
+{
+public:
+	virtual ~IBasicTileSource() = default;
+
+	virtual ImageSize GetImageSize() const = 0;
+	virtual BasicTile<TileSize> LoadTile(int tileX, int tileY) const = 0;
+
+	//       path:    
+	//   ,   
+	virtual bool IsBackedBy(const std::string& /*path*/) const
+	{
+		return false;
+	}
+};
+
+using ITileSource = IBasicTileSource<Tile::SIZE>;
+
+namespace detail
+{
+	inline bool IsSameFile(const std::string& a, const std::string& b)
+	{
+		std::error_code error;
+		return std::filesystem::equivalent(a, b, error);
+	}
+} // namespace detail
+
+//   ,     :  
+//  ,  ,     ,    CoW<Tile>.
+//  ,      ;  
+//    ,      
+template <unsigned TileSize>
+class BasicTileCache
+{
+public:
+	using Tile = BasicTile<TileSize>;
+	using TileSource = IBasicTileSource<TileSize>;
+
+	explicit BasicTileCache(std::shared_ptr<const TileSource> source)
+		: m_source(std::move(source))
+	{
+		const auto size = m_source->GetImageSize();
+		m_tilesX = (size.width + static_cast<int>(Tile::SIZE) - 1) / static_cast<int>(Tile::SIZE);
+		const int tilesY = (size.height + static_cast<int>(Tile::SIZE) - 1) / static_cast<int>(Tile::SIZE);
+		m_slots.resize(static_cast<size_t>(m_tilesX) * static_cast<size_t>(tilesY));
+		m_released.assign(m_slots.size(), false);
+	}
+
+	BasicTileCache(const BasicTileCache&) = delete;
+	BasicTileCache& operator=(const BasicTileCache&) = delete;
+
+	// nullptr  Detach()
+	const TileSource* GetSource() const noexcept
+	{
+		std::lock_guard lock{ m_mutex };
+		return m_source.get();
+	}
+
+	// keep = false,      
+	CoW<Tile> Load(size_t index, bool keep)
+	{
+		std::shared_ptr<const TileSource> source;
+		{
+			std::lock_guard lock{ m_mutex };
+			auto& slot = m_slots[index];
+			if (slot)
+			{
+				CoW<Tile> tile = *slot;
+				if (!keep)
+				{
+					ReleaseSlot(index);
+				}
+				return tile;
+			}
+			source = m_source;
+		}
+
+		//    :    
+		CoW<Tile> tile{ source->LoadTile(static_cast<int>(index % static_cast<size_t>(m_tilesX)), static_cast<int>(index / static_cast<size_t>(m_tilesX))) };
+		std::lock_guard lock{ m_mutex };
+		auto& slot = m_slots[index];
+		if (slot) return *slot;
+		if (keep)
+		{
+			slot = tile;
+		}
+		else
+		{
+			ReleaseSlot(index);
+		}
+		return tile;
+	}
+
+	void Release(size_t index)
+	{
+		std::lock_guard lock{ m_mutex };
+		ReleaseSlot(index);
+	}
+
+	//       Release:   
+	void Pin(size_t index)
+	{
+		{
+			std::lock_guard lock{ m_mutex };
+			if (m_slots[index] || m_released[index] || !m_source) return;
+		}
+		Load(index, true);
+	}
+
+	//           
+	void Detach()
+	{
+		for (size_t index = 0; index < m_slots.size(); ++index)
+		{
+			Pin(index);
+		}
+		std::lock_guard lock{ m_mutex };
+		m_source.reset();
+	}
+
+private:
+	void ReleaseSlot(size_t index) noexcept
+	{
+		m_slots[index].reset();
+		m_released[index] = true;
+	}
+
+	mutable std::mutex m_mutex;
+	std::shared_ptr<const TileSource> m_source;
+	int m_tilesX{};
+	std::vector<std::optional<CoW<Tile>>> m_slots;
+	std::vector<bool> m_released;
+};
\ No newline at end of file
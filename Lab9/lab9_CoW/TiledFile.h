@@ -0,0 +1,317 @@
+#pragma once
+
+#include "Image.h"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/*
+  ,   little-endian:
+	  -  "L9TILES1",  ,    
+	     -    :   (0 -  )  
+	    - SIZE * SIZE    ,   
+        
+     ,     
+*/
+
+namespace tiled
+{
+	constexpr std::array<char, 8> SIGNATURE{ 'L', '9', 'T', 'I', 'L', 'E', 'S', '1' };
+	constexpr size_t HEADER_SIZE = SIGNATURE.size() + 3 * 4;
+	constexpr size_t INDEX_ENTRY_SIZE = 8 + 4;
+
+	template <unsigned TileSize>
+	constexpr size_t PAYLOAD_SIZE = TileSize * TileSize * 4;
+
+	struct IndexEntry
+	{
+		uint64_t offset = 0;
+		uint32_t color = 0;
+	};
+
+	template <size_t N>
+	void PutLittleEndian(char* out, uint64_t value) noexcept
+	{
+		for (size_t i = 0; i < N; ++i)
+		{
+			out[i] = static_cast<char>(value >> (8 * i) & 0xFF);
+		}
+	}
+
+	template <size_t N>
+	uint64_t GetLittleEndian(const char* in) noexcept
+	{
+		uint64_t value = 0;
+		for (size_t i = 0; i < N; ++i)
+		{
+			value |= static_cast<uint64_t>(static_cast<unsigned char>(in[i])) << (8 * i);
+		}
+		return value;
+	}
+
+	//        32 
+	inline uint64_t GetIndexOffset(uint64_t tileIndex) noexcept
+	{
+		return HEADER_SIZE + tileIndex * INDEX_ENTRY_SIZE;
+	}
+
+	inline void WriteHeader(std::ostream& out, ImageSize size, unsigned tileSize)
+	{
+		std::array<char, HEADER_SIZE> header{};
+		std::copy(SIGNATURE.begin(), SIGNATURE.end(), header.begin());
+		PutLittleEndian<4>(header.data() + 8, tileSize);
+		PutLittleEndian<4>(header.data() + 12, static_cast<uint32_t>(size.width));
+		PutLittleEndian<4>(header.data() + 16, static_cast<uint32_t>(size.height));
+		out.write(header.data(), header.size());
+	}
+
+	inline ImageSize ReadHeader(std::istream& in, unsigned tileSize)
+	{
+		std::array<char, HEADER_SIZE> header{};
+		if (!in.read(header.data(), header.size())
+			|| !std::equal(SIGNATURE.begin(), SIGNATURE.end(), header.begin()))
+		{
+			throw std::runtime_error("Not a tiled image file");
+		}
+		if (GetLittleEndian<4>(header.data() + 8) != tileSize)
+		{
+			throw std::runtime_error("Tiled image file uses another tile size");
+		}
+
+		return {
+			static_cast<int>(GetLittleEndian<4>(header.data() + 12)),
+			static_cast<int>(GetLittleEndian<4>(header.data() + 16)),
+		};
+	}
+
+	inline void WriteIndexEntry(std::ostream& out, size_t tileIndex, IndexEntry entry)
+	{
+		std::array<char, INDEX_ENTRY_SIZE> bytes{};
+		PutLittleEndian<8>(bytes.data(), entry.offset);
+		PutLittleEndian<4>(bytes.data() + 8, entry.color);
+		out.seekp(static_cast<std::streamoff>(GetIndexOffset(tileIndex)));
+		out.write(bytes.data(), bytes.size());
+	}
+
+	inline std::vector<IndexEntry> ReadIndex(std::istream& in, size_t tileCount)
+	{
+		std::vector<char> bytes(tileCount * INDEX_ENTRY_SIZE);
+		in.seekg(static_cast<std::streamoff>(GetIndexOffset(0)));
+		if (!in.read(bytes.data(), static_cast<std::streamsize>(bytes.size())))
+		{
+			throw std::runtime_error("Tiled image file is truncated");
+		}
+
+		std::vector<IndexEntry> index(tileCount);
+		for (size_t i = 0; i < tileCount; ++i)
+		{
+			index[i].offset = GetLittleEndian<8>(bytes.data() + i * INDEX_ENTRY_SIZE);
+			index[i].color = static_cast<uint32_t>(GetLittleEndian<4>(bytes.data() + i * INDEX_ENTRY_SIZE + 8));
+		}
+		return index;
+	}
+
+	template <unsigned TileSize>
+	void WritePayload(std::ostream& out, uint64_t offset, const uint32_t* pixels)
+	{
+		std::array<char, PAYLOAD_SIZE<TileSize>> bytes{};
+		for (size_t i = 0; i < TileSize * TileSize; ++i)
+		{
+			PutLittleEndian<4>(bytes.data() + i * 4, pixels[i]);
+		}
+		out.seekp(static_cast<std::streamoff>(offset));
+		out.write(bytes.data(), bytes.size());
+	}
+
+	//    :  -   ,  -  
+	//    (     )
+	template <unsigned TileSize>
+	IndexEntry StoreTile(std::fstream& file, size_t tileIndex, const BasicTile<TileSize>& tile, IndexEntry entry)
+	{
+		if (const uint32_t* pixels = tile.GetData())
+		{
+			if (entry.offset == 0)
+			{
+				file.seekp(0, std::ios::end);
+				entry.offset = static_cast<uint64_t>(file.tellp());
+			}
+			WritePayload<TileSize>(file, entry.offset, pixels);
+		}
+		else
+		{
+			//          
+			entry = { 0, tile.GetPixel({ 0, 0 }) };
+		}
+
+		WriteIndexEntry(file, tileIndex, entry);
+		return entry;
+	}
+} // namespace tiled
+
+//   -   ,   
+template <unsigned TileSize>
+class BasicTiledFileSource : public IBasicTileSource<TileSize>
+{
+public:
+	using Tile = BasicTile<TileSize>;
+
+	explicit BasicTiledFileSource(const std::string& path)
+		: m_path(path)
+		, m_file(path, std::ios::binary)
+	{
+		if (!m_file)
+		{
+			throw std::runtime_error("Failed to open " + path);
+		}
+
+		m_size = tiled::ReadHeader(m_file, TileSize);
+		if (m_size.width <= 0 || m_size.height <= 0)
+		{
+			throw std::runtime_error("Invalid tiled image size");
+		}
+		m_tilesX = (m_size.width + static_cast<int>(Tile::SIZE) - 1) / static_cast<int>(Tile::SIZE);
+		const int tilesY = (m_size.height + static_cast<int>(Tile::SIZE) - 1) / static_cast<int>(Tile::SIZE);
+		m_index = tiled::ReadIndex(m_file, static_cast<size_t>(m_tilesX) * static_cast<size_t>(tilesY));
+	}
+
+	ImageSize GetImageSize() const override
+	{
+		return m_size;
+	}
+
+	bool IsBackedBy(const std::string& path) const override
+	{
+		return detail::IsSameFile(m_path, path);
+	}
+
+	//    ,  SaveTiledIncremental  
+	void ReloadIndex() const
+	{
+		std::lock_guard lock{ m_mutex };
+		m_file.clear();
+		m_index = tiled::ReadIndex(m_file, m_index.size());
+	}
+
+	Tile LoadTile(int tileX, int tileY) const override
+	{
+		std::array<char, tiled::PAYLOAD_SIZE<TileSize>> bytes{};
+		tiled::IndexEntry entry;
+		{
+			//          
+			std::lock_guard lock{ m_mutex };
+			entry = m_index[static_cast<size_t>(tileY) * static_cast<size_t>(m_tilesX) + static_cast<size_t>(tileX)];
+			if (entry.offset == 0) return Tile{ entry.color };
+
+			m_file.seekg(static_cast<std::streamoff>(entry.offset));
+			if (!m_file.read(bytes.data(), bytes.size()))
+			{
+				throw std::runtime_error("Tiled image file is truncated");
+			}
+		}
+
+		Tile tile{ entry.color };
+		uint32_t* pixels = tile.GetMutableData();
+		for (size_t i = 0; i < Tile::SIZE * Tile::SIZE; ++i)
+		{
+			pixels[i] = static_cast<uint32_t>(tiled::GetLittleEndian<4>(bytes.data() + i * 4));
+		}
+		return tile;
+	}
+
+private:
+	std::string m_path;
+	mutable std::ifstream m_file;
+	mutable std::mutex m_mutex;
+	ImageSize m_size{};
+	int m_tilesX{};
+	mutable std::vector<tiled::IndexEntry> m_index;
+};
+
+//          .
+//   LoadTiled(path)   ,   
+//     
+template <unsigned TileSize>
+void SaveTiled(BasicImage<TileSize>& img, const std::string& path)
+{
+	img.ReleaseFile(path);
+	{
+		std::ofstream create{ path, std::ios::binary | std::ios::trunc };
+		if (!create)
+		{
+			throw std::runtime_error("Failed to open " + path);
+		}
+		tiled::WriteHeader(create, img.GetImageSize(), TileSize);
+		const std::vector<char> index(img.GetTileCount() * tiled::INDEX_ENTRY_SIZE);
+		create.write(index.data(), static_cast<std::streamsize>(index.size()));
+	}
+
+	std::fstream file{ path, std::ios::binary | std::ios::in | std::ios::out };
+	if (!file)
+	{
+		throw std::runtime_error("Failed to open " + path);
+	}
+	for (size_t index = 0; index < img.GetTileCount(); ++index)
+	{
+		tiled::StoreTile(file, index, *img.GetTile(index), {});
+	}
+	if (!file.flush())
+	{
+		throw std::runtime_error("Failed to write " + path);
+	}
+	img.ClearDirtyTiles();
+}
+
+//     ,    .
+//         (SaveTiled  LoadTiled)
+template <unsigned TileSize>
+void SaveTiledIncremental(BasicImage<TileSize>& img, const std::string& path)
+{
+	std::fstream file{ path, std::ios::binary | std::ios::in | std::ios::out };
+	if (!file)
+	{
+		throw std::runtime_error("Failed to open " + path);
+	}
+
+	const auto size = tiled::ReadHeader(file, TileSize);
+	if (size.width != img.GetImageSize().width || size.height != img.GetImageSize().height)
+	{
+		throw std::runtime_error("Tiled image file has another size");
+	}
+
+	//     ,     
+	// ,    
+	const auto dirty = img.GetDirtyTiles();
+	const bool backing = img.IsBackedBy(path);
+	if (backing)
+	{
+		img.PinSourceTiles(dirty);
+	}
+
+	const auto index = tiled::ReadIndex(file, img.GetTileCount());
+	for (size_t tileIndex : dirty)
+	{
+		tiled::StoreTile(file, tileIndex, *img.GetTile(tileIndex), index[tileIndex]);
+	}
+	if (!file.flush())
+	{
+		throw std::runtime_error("Failed to write " + path);
+	}
+	img.ClearDirtyTiles();
+
+	if (const auto* source = dynamic_cast<const BasicTiledFileSource<TileSize>*>(backing ? img.GetTileSource() : nullptr))
+	{
+		source->ReloadIndex();
+	}
+}
+
+//   ,     
+template <typename ImageT = Image>
+ImageT LoadTiled(const std::string& path)
+{
+	return ImageT{ std::make_shared<const BasicTiledFileSource<ImageT::Tile::SIZE>>(path) };
+}
\ No newline at end of file
@@ -1,8 +1,17 @@
-﻿#include "Image.h"
+﻿#include "BoundedQueue.h"
+#include "Image.h"
 #include "ImageUtils.h"
 #include "Drawer.h"
 
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
 #include <iostream>
+#include <optional>
+#include <sstream>
+#include <thread>
+#include <unordered_set>
 
 static void RunSolve()
 {
@@ -18,7 +27,269 @@ static void RunSolve()
     std::cout << "Image saved\n";
 }
 
-int main()
+namespace
 {
-    RunSolve();
+    using Clock = std::chrono::steady_clock;
+
+    uint32_t ParseColor(const std::string& text)
+    {
+        size_t end = 0;
+        const auto color = std::stoul(text, &end, 16);
+        if (end != text.size() || color > 0xFFFFFFFF)
+        {
+            throw std::invalid_argument("invalid color " + text);
+        }
+        return static_cast<uint32_t>(color);
+    }
+
+    // одна команда сценария без имени, которое уже прочитано из words
+    Shape ParseCommand(const std::string& command, std::istringstream& words)
+    {
+        std::string color;
+        Point a{};
+        Point b{};
+        int radius = 0;
+        if (command == "line" && words >> a.x >> a.y >> b.x >> b.y >> color)
+        {
+            return LineShape{ a, b, ParseColor(color) };
+        }
+        if (command == "circle" && words >> a.x >> a.y >> radius >> color)
+        {
+            return CircleShape{ a, radius, ParseColor(color) };
+        }
+        if (command == "fill" && words >> a.x >> a.y >> radius >> color)
+        {
+            return FilledCircleShape{ a, radius, ParseColor(color) };
+        }
+        if (command == "polygon" && words >> color)
+        {
+            PolygonShape polygon{ {}, ParseColor(color) };
+            while (words >> a.x >> a.y)
+            {
+                polygon.vertices.push_back(a);
+            }
+            return polygon;
+        }
+        throw std::invalid_argument("unknown command or missing arguments");
+    }
+
+    // сценарий рисования, по команде в строке (# - комментарий), цвет - шестнадцатеричный:
+    //   line x0 y0 x1 y1 color
+    //   circle cx cy r color
+    //   fill cx cy r color
+    //   polygon color x0 y0 x1 y1 x2 y2 ...
+    std::vector<Shape> LoadScript(const std::string& path)
+    {
+        std::ifstream file{ path };
+        if (!file)
+        {
+            throw std::runtime_error("Failed to open " + path);
+        }
+
+        std::vector<Shape> shapes;
+        std::string line;
+        for (int number = 1; std::getline(file, line); ++number)
+        {
+            std::istringstream words{ line.substr(0, line.find('#')) };
+            std::string command;
+            if (!(words >> command)) continue;
+
+            try
+            {
+                shapes.push_back(ParseCommand(command, words));
+            }
+            catch (const std::logic_error& e)
+            {
+                throw std::runtime_error(path + ":" + std::to_string(number) + ": " + e.what());
+            }
+        }
+        return shapes;
+    }
+
+    std::vector<std::string> LoadList(const std::string& path)
+    {
+        std::ifstream file{ path };
+        if (!file)
+        {
+            throw std::runtime_error("Failed to open " + path);
+        }
+
+        std::vector<std::string> inputs;
+        std::string line;
+        while (std::getline(file, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+            if (!line.empty())
+            {
+                inputs.push_back(line);
+            }
+        }
+        return inputs;
+    }
+
+    struct Job
+    {
+        std::string input;
+        std::string output;
+        Image image;
+    };
+
+    struct StageStats
+    {
+        const char* name;
+        std::atomic<size_t> done{};
+        std::atomic<size_t> failed{};
+        std::atomic<Clock::rep> busy{};
+    };
+
+    // вызывает work для элемента, учитывая время работы; ошибка в одном
+    // файле не останавливает остальные
+    template <typename Work>
+    bool RunItem(StageStats& stage, const std::string& input, Work&& work)
+    {
+        const auto start = Clock::now();
+        try
+        {
+            work();
+            ++stage.done;
+            stage.busy += (Clock::now() - start).count();
+            return true;
+        }
+        catch (const std::exception& e)
+        {
+            ++stage.failed;
+            stage.busy += (Clock::now() - start).count();
+            std::cerr << stage.name << ": " << input << ": " << e.what() << "\n";
+            return false;
+        }
+    }
+
+    double ToSeconds(Clock::duration duration)
+    {
+        return std::chrono::duration<double>(duration).count();
+    }
+
+    void PrintReport(const std::vector<StageStats*>& stages, const std::vector<std::pair<const char*, QueueStats>>& queues, Clock::duration wall)
+    {
+        std::cout << std::fixed << std::setprecision(3)
+            << "stage     done  failed  busy, s  items/s\n";
+        for (const auto* stage : stages)
+        {
+            const double busy = ToSeconds(Clock::duration{ stage->busy.load() });
+            std::cout << std::left << std::setw(8) << stage->name << std::right
+                << std::setw(6) << stage->done << std::setw(8) << stage->failed
+                << std::setw(9) << busy << std::setw(9) << (busy > 0 ? static_cast<double>(stage->done) / busy : 0.0) << "\n";
+        }
+
+        // полная очередь и ожидание производителя - узкое место после неё,
+        // пустая очередь и ожидание потребителя - до неё
+        std::cout << "\nqueue     capacity  average  max  push wait, s  pop wait, s\n";
+        for (const auto& [name, stats] : queues)
+        {
+            std::cout << std::left << std::setw(8) << name << std::right
+                << std::setw(10) << stats.capacity << std::setw(9) << stats.averageSize << std::setw(5) << stats.maxSize
+                << std::setw(14) << ToSeconds(stats.pushWait) << std::setw(13) << ToSeconds(stats.popWait) << "\n";
+        }
+
+        const double seconds = ToSeconds(wall);
+        std::cout << "\nwall " << seconds << " s, " << (seconds > 0 ? static_cast<double>(stages.back()->done) / seconds : 0.0) << " images/s\n";
+    }
+
+    // чтение, рисование и запись идут в своих потоках и перекрываются во времени,
+    // между ними - очереди на capacity изображений
+    int RunBatch(const std::string& listPath, const std::string& scriptPath, const std::string& outDir, size_t capacity)
+    {
+        const auto inputs = LoadList(listPath);
+        const auto shapes = LoadScript(scriptPath);
+        std::filesystem::create_directories(outDir);
+
+        StageStats decode{ "decode" };
+        StageStats draw{ "draw" };
+        StageStats encode{ "encode" };
+        BoundedQueue<Job> decoded{ capacity };
+        BoundedQueue<Job> drawn{ capacity };
+        const auto start = Clock::now();
+
+        std::thread decoder{ [&] {
+            std::unordered_set<std::string> outputs;
+            for (const auto& input : inputs)
+            {
+                std::string output;
+                std::optional<Image> image;
+                if (RunItem(decode, input, [&] {
+                    // одноимённые файлы из разных каталогов записались бы в один результат
+                    output = (std::filesystem::path{ outDir } / std::filesystem::path{ input }.filename()).string();
+                    if (!outputs.insert(output).second)
+                    {
+                        throw std::runtime_error("Output " + output + " is taken by another input");
+                    }
+                    image.emplace(ImportImage(input));
+                }))
+                {
+                    decoded.Push({ input, std::move(output), std::move(*image) });
+                }
+            }
+            decoded.Close();
+        } };
+
+        std::thread drawer{ [&] {
+            while (auto job = decoded.Pop())
+            {
+                if (RunItem(draw, job->input, [&] { DrawBatch(job->image, shapes); }))
+                {
+                    drawn.Push(std::move(*job));
+                }
+            }
+            drawn.Close();
+        } };
+
+        // запись идёт в этом потоке, формат результата - по расширению входного файла
+        while (auto job = drawn.Pop())
+        {
+            RunItem(encode, job->input, [&] {
+                if (std::filesystem::path{ job->output }.extension() == ".qoi")
+                {
+                    SaveQoi(job->image, job->output);
+                }
+                else
+                {
+                    SaveImage(job->image, job->output);
+                }
+            });
+        }
+
+        decoder.join();
+        drawer.join();
+        PrintReport({ &decode, &draw, &encode }, { { "decoded", decoded.GetStats() }, { "drawn", drawn.GetStats() } }, Clock::now() - start);
+        return decode.failed + draw.failed + encode.failed == 0 ? 0 : 1;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc == 1)
+    {
+        RunSolve();
+        return 0;
+    }
+
+    const std::string mode = argv[1];
+    if (mode != "--batch" || (argc != 4 && argc != 5 && argc != 6))
+    {
+        std::cerr << "usage: " << argv[0] << " [--batch list.txt script.txt [out_dir] [queue_capacity]]\n";
+        return 2;
+    }
+
+    try
+    {
+        return RunBatch(argv[2], argv[3], argc > 4 ? argv[4] : "out", argc > 5 ? std::stoul(argv[5]) : 4);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
 }
\ No newline at end of file
@@ -2,7 +2,21 @@
 
 #include "../../../catch2/catch.hpp"
 
+#include "../lab9_CoW/BoundedQueue.h"
+#include "../lab9_CoW/Drawer.h"
 #include "../lab9_CoW/Image.h"
+#include "../lab9_CoW/ImageExpr.h"
+#include "../lab9_CoW/ImageHistory.h"
+#include "../lab9_CoW/ImageStats.h"
+#include "../lab9_CoW/ImageUtils.h"
+#include "../lab9_CoW/PagedImage.h"
+#include "../lab9_CoW/TiledFile.h"
+
+#include <cstdio>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <thread>
 
 class TestImage : public Image
 {
@@ -165,4 +179,1974 @@ TEST_CASE("16 x 16 px. modify twice - keep sharing pattern")
 	REQUIRE(count1 == 1);
 	REQUIRE(count3 == 3);
 	REQUIRE(tiles[static_cast<size_t>(index)].GetInstanceCount() == 1);
+}
+
+namespace
+{
+	template <typename ImageT = Image>
+	ImageT MakeGradient(ImageSize size)
+	{
+		ImageT img{ size };
+		for (int y = 0; y < size.height; ++y)
+		{
+			for (int x = 0; x < size.width; ++x)
+			{
+				img.SetPixel({ x, y }, static_cast<uint32_t>((x * 7) << 16 | (y * 5) << 8 | (x + y)) & 0xFFFFFF);
+			}
+		}
+		return img;
+	}
+
+	template <unsigned LeftTileSize, unsigned RightTileSize>
+	void RequireSamePixels(const BasicImage<LeftTileSize>& lhs, const BasicImage<RightTileSize>& rhs)
+	{
+		REQUIRE(lhs.GetImageSize().width == rhs.GetImageSize().width);
+		REQUIRE(lhs.GetImageSize().height == rhs.GetImageSize().height);
+		for (int y = 0; y < lhs.GetImageSize().height; ++y)
+		{
+			for (int x = 0; x < lhs.GetImageSize().width; ++x)
+			{
+				REQUIRE(lhs.GetPixel({ x, y }) == rhs.GetPixel({ x, y }));
+			}
+		}
+	}
+}
+
+TEST_CASE("row read/write crosses tile borders")
+{
+	Image img({ 19, 3 });
+	std::vector<uint32_t> row(19);
+	for (size_t i = 0; i < row.size(); ++i)
+	{
+		row[i] = static_cast<uint32_t>(i + 1);
+	}
+
+	img.WriteRow(1, row.data());
+	REQUIRE(img.GetPixel({ 0, 1 }) == 1);
+	REQUIRE(img.GetPixel({ 8, 1 }) == 9);
+	REQUIRE(img.GetPixel({ 18, 1 }) == 19);
+	REQUIRE(img.GetPixel({ 18, 0 }) == 0);
+
+	std::vector<uint32_t> copy(19);
+	img.ReadRow(1, copy.data());
+	REQUIRE(copy == row);
+	REQUIRE_THROWS_AS(img.ReadRow(3, copy.data()), std::out_of_range);
+}
+
+TEST_CASE("P6 save and import keep every pixel")
+{
+	const Image img = MakeGradient({ 21, 13 });
+	SaveImage(img, "test_p6.ppm", PpmFormat::Raw);
+
+	std::ifstream file{ "test_p6.ppm", std::ios::binary };
+	std::string magic;
+	file >> magic;
+	file.close();
+	REQUIRE(magic == "P6");
+
+	RequireSamePixels(img, ImportImage("test_p6.ppm"));
+	std::remove("test_p6.ppm");
+}
+
+TEST_CASE("P3 fallback is still written and detected on import")
+{
+	const Image img = MakeGradient({ 10, 9 });
+	SaveImage(img, "test_p3.ppm", PpmFormat::Plain);
+
+	std::ifstream file{ "test_p3.ppm", std::ios::binary };
+	std::string magic;
+	file >> magic;
+	file.close();
+	REQUIRE(magic == "P3");
+
+	RequireSamePixels(img, ImportImage("test_p3.ppm"));
+	std::remove("test_p3.ppm");
+}
+
+TEST_CASE("P3 import keeps blue channel and scales maxval")
+{
+	{
+		std::ofstream file{ "test_maxv.ppm", std::ios::binary };
+		file << "P3\n# comment\n2 1\n15\n15 0 0  0 0 15\n";
+	}
+
+	const Image img = ImportImage("test_maxv.ppm");
+	REQUIRE(img.GetPixel({ 0, 0 }) == 0xFF0000);
+	REQUIRE(img.GetPixel({ 1, 0 }) == 0x0000FF);
+	std::remove("test_maxv.ppm");
+}
+
+TEST_CASE("unknown PPM signature is rejected")
+{
+	{
+		std::ofstream file{ "test_bad.ppm", std::ios::binary };
+		file << "P5\n1 1\n255\n";
+	}
+
+	REQUIRE_THROWS_AS(ImportImage("test_bad.ppm"), std::runtime_error);
+	std::remove("test_bad.ppm");
+}
+
+TEST_CASE("QOI encoder follows the specification byte by byte")
+{
+	// повтор начального пикселя, затем QOI_OP_LUMA
+	Image img{ { 3, 1 }, 0xFF000000 };
+	img.SetPixel({ 2, 0 }, 0xFF010203);
+	std::ostringstream out;
+	EncodeQoi(img, out);
+
+	const std::string expected{
+		'q', 'o', 'i', 'f', 0, 0, 0, 3, 0, 0, 0, 1, 4, 0,
+		'\xC1', '\xA2', '\x79',
+		0, 0, 0, 0, 0, 0, 0, 1
+	};
+	REQUIRE(out.str() == expected);
+}
+
+TEST_CASE("QOI keeps every pixel and alpha")
+{
+	Image img = MakeGradient({ 70, 23 });
+	// длинный повтор через несколько строк и разная прозрачность
+	img.FillRect({ 0, 5 }, { 69, 7 }, 0x80FFFFFF);
+	std::mt19937 random{ 21 };
+	for (int x = 0; x < 70; ++x)
+	{
+		img.SetPixel({ x, 20 }, static_cast<uint32_t>(random()));
+	}
+	img.SetPixel({ 3, 21 }, img.GetPixel({ 60, 20 }));
+
+	SaveQoi(img, "test_img.qoi");
+	RequireSamePixels(img, ImportQoi("test_img.qoi"));
+	RequireSamePixels(img, ImportImage("test_img.qoi"));
+	std::remove("test_img.qoi");
+
+	std::stringstream stream;
+	EncodeQoi(Image{ { 1000, 1000 }, 0x12345678 }, stream);
+	// одноцветное изображение - QOI_OP_RGBA и повторы по 62 пикселя
+	REQUIRE(stream.str().size() == detail::QOI_HEADER_SIZE + 5 + (1000 * 1000 - 1 + 61) / 62 + 8);
+	RequireSamePixels(Image{ { 1000, 1000 }, 0x12345678 }, DecodeQoi(stream));
+}
+
+TEST_CASE("QOI from a PPM image has three opaque channels")
+{
+	{
+		std::ofstream ppm{ "test_rgb.ppm", std::ios::binary };
+		ppm << "P6\n3 1\n255\n";
+		ppm.write("\x01\x02\x03\x01\x02\x03\x01\x02\x03", 9);
+	}
+	const Image img = ImportImage("test_rgb.ppm");
+	std::remove("test_rgb.ppm");
+	REQUIRE(img.GetPixel({ 0, 0 }) == 0x010203);
+
+	// альфа 0xFF совпадает с начальным пикселем: QOI_OP_LUMA без QOI_OP_RGBA
+	std::stringstream out;
+	EncodeQoi(img, out);
+	const std::string expected{
+		'q', 'o', 'i', 'f', 0, 0, 0, 3, 0, 0, 0, 1, 3, 0,
+		'\xA2', '\x79', '\xC1',
+		0, 0, 0, 0, 0, 0, 0, 1
+	};
+	REQUIRE(out.str() == expected);
+
+	const Image decoded = DecodeQoi(out);
+	RequireSamePixels(img, decoded);
+	std::ostringstream again;
+	EncodeQoi(decoded, again);
+	REQUIRE(again.str() == expected);
+}
+
+TEST_CASE("broken QOI data is rejected")
+{
+	std::ostringstream out;
+	EncodeQoi(MakeGradient({ 9, 9 }), out);
+	const std::string data = out.str();
+
+	std::istringstream truncated{ data.substr(0, data.size() - 20) };
+	REQUIRE_THROWS_AS(DecodeQoi(truncated), std::runtime_error);
+
+	std::string zeroWidth = data;
+	zeroWidth[7] = 0;
+	std::istringstream empty{ zeroWidth };
+	REQUIRE_THROWS_AS(DecodeQoi(empty), std::runtime_error);
+}
+
+TEST_CASE("mapped P6 image matches eager import")
+{
+	const Image img = MakeGradient({ 20, 11 });
+	SaveImage(img, "test_map.ppm");
+
+	{
+		const Image mapped = MapImage("test_map.ppm");
+		RequireSamePixels(img, mapped);
+	}
+	std::remove("test_map.ppm");
+}
+
+TEST_CASE("mapped image materializes tiles on first access only")
+{
+	SaveImage(MakeGradient({ 32, 32 }), "test_lazy.ppm");
+
+	{
+		const int before = Tile::GetInstanceCount();
+		Image mapped = MapImage("test_lazy.ppm");
+		// один общий тайл-заглушка на всё изображение
+		REQUIRE(Tile::GetInstanceCount() == before + 1);
+
+		REQUIRE(mapped.GetPixel({ 9, 1 }) == (9 * 7 << 16 | 1 * 5 << 8 | 10));
+		REQUIRE(Tile::GetInstanceCount() == before + 2);
+
+		mapped.SetPixel({ 30, 30 }, 0xABCDEF);
+		REQUIRE(mapped.GetPixel({ 30, 30 }) == 0xABCDEF);
+		REQUIRE(mapped.GetPixel({ 29, 30 }) == (29 * 7 << 16 | 30 * 5 << 8 | 59));
+		REQUIRE(Tile::GetInstanceCount() == before + 3);
+	}
+	std::remove("test_lazy.ppm");
+}
+
+TEST_CASE("copies of a mapped image share loaded tiles")
+{
+	SaveImage(MakeGradient({ 64, 64 }), "test_map_copy.ppm");
+
+	{
+		const Image mapped = MapImage("test_map_copy.ppm");
+		const Image copy = mapped;
+		REQUIRE(mapped.GetPixel({ 9, 1 }) == copy.GetPixel({ 9, 1 }));
+		REQUIRE(mapped.GetPixel({ 63, 63 }) == copy.GetPixel({ 63, 63 }));
+
+		// каждый тайл читается один раз, обе копии ссылаются на него;
+		// общая заглушка незагруженных тайлов освобождается
+		const int before = Tile::GetInstanceCount();
+		mapped.ForEachTile([](const TilePixels<const uint32_t>&) {});
+		copy.ForEachTile([](const TilePixels<const uint32_t>&) {});
+		REQUIRE(Tile::GetInstanceCount() == before + static_cast<int>(mapped.GetTileCount()) - 3);
+		REQUIRE(copy.GetChangedTiles(mapped).empty());
+	}
+	std::remove("test_map_copy.ppm");
+}
+
+TEST_CASE("mapped image can be saved over its own file")
+{
+	const Image original = MakeGradient({ 40, 24 });
+	SaveImage(original, "test_map_self.ppm");
+
+	{
+		Image mapped = MapImage("test_map_self.ppm");
+		const Image copy = mapped;
+		DrawLine(mapped, { 0, 0 }, { 39, 23 }, 0xFF0000);
+		REQUIRE(mapped.IsBackedBy("test_map_self.ppm"));
+		SaveImage(mapped, "test_map_self.ppm");
+		REQUIRE_FALSE(mapped.IsBackedBy("test_map_self.ppm"));
+
+		RequireSamePixels(ImportImage("test_map_self.ppm"), mapped);
+		// копия по-прежнему видит исходное содержимое файла
+		RequireSamePixels(copy, original);
+	}
+	std::remove("test_map_self.ppm");
+}
+
+TEST_CASE("only P6 files can be mapped")
+{
+	SaveImage(MakeGradient({ 4, 4 }), "test_map_p3.ppm", PpmFormat::Plain);
+	REQUIRE_THROWS_AS(MapImage("test_map_p3.ppm"), std::runtime_error);
+	std::remove("test_map_p3.ppm");
+}
+
+TEST_CASE("fixed block pool reuses released blocks")
+{
+	FixedBlockPool pool{ sizeof(Tile), alignof(Tile), 4 };
+	void* first = pool.Allocate();
+	void* second = pool.Allocate();
+	REQUIRE(first != second);
+	REQUIRE(reinterpret_cast<uintptr_t>(first) % alignof(Tile) == 0);
+
+	pool.Deallocate(first);
+	REQUIRE(pool.Allocate() == first);
+
+	// новый slab, когда свободные блоки кончились
+	std::vector<void*> blocks;
+	for (int i = 0; i < 10; ++i)
+	{
+		blocks.push_back(pool.Allocate());
+	}
+	std::sort(blocks.begin(), blocks.end());
+	REQUIRE(std::adjacent_find(blocks.begin(), blocks.end()) == blocks.end());
+}
+
+TEST_CASE("unsharing a pooled tile copies pixels and keeps instance accounting")
+{
+	const int before = Tile::GetInstanceCount();
+	CoW<Tile> original{ 0x123456u };
+	CoW<Tile> copy = original;
+	REQUIRE(Tile::GetInstanceCount() == before + 1);
+
+	copy--->SetPixel({ 3, 4 }, 0xFFFFFF);
+	REQUIRE(Tile::GetInstanceCount() == before + 2);
+	REQUIRE(original.GetInstanceCount() == 1);
+	REQUIRE(copy->GetPixel({ 3, 4 }) == 0xFFFFFF);
+	REQUIRE(copy->GetPixel({ 0, 0 }) == 0x123456);
+	REQUIRE(original->GetPixel({ 3, 4 }) == 0x123456);
+
+	// освобождённый блок сразу уходит следующей копии
+	const Tile* released = &*copy;
+	copy = original;
+	CoW<Tile> another = original;
+	another--->SetPixel({ 0, 0 }, 1);
+	REQUIRE(&*another == released);
+}
+
+TEST_CASE("copy-on-write counters track unshare copies per image")
+{
+	CoWCounters::Enable();
+	CoWCounters::Reset();
+
+	Image original({ 32, 16 }, 0x10);
+	original.SetPixel({ 0, 0 }, 0x20);
+	auto stats = original.GetSharingStats();
+	REQUIRE(stats.copies.unshareCopies == 1);
+	REQUIRE(stats.copies.bytesCopied == sizeof(Tile));
+	// общий одноцветный тайл в семи ячейках считается один раз
+	REQUIRE(stats.uniqueTiles == 1);
+	REQUIRE(stats.sharedTiles == 1);
+	REQUIRE(stats.distinctTiles == 2);
+	REQUIRE(stats.solidTiles == 1);
+	REQUIRE(stats.sharedBytes == sizeof(Tile));
+	REQUIRE(stats.uniqueBytes == original.GetTile(0)->GetByteSize());
+
+	// копия наследует счётчики, после сброса видны только её копирования
+	Image copy = original;
+	REQUIRE(copy.GetSharingStats().copies.unshareCopies == 1);
+	copy.ResetCoWStats();
+	Tile::ResetPeakInstanceCount();
+	const int before = Tile::GetInstanceCount();
+	copy.SetPixel({ 1, 1 }, 0x30);
+	copy.SetPixel({ 2, 2 }, 0x30);
+	copy.SetPixel({ 9, 9 }, 0x30);
+	stats = copy.GetSharingStats();
+	REQUIRE(stats.copies.unshareCopies == 2);
+	REQUIRE(stats.copies.bytesCopied == original.GetTile(0)->GetByteSize() + sizeof(Tile));
+	REQUIRE(stats.uniqueTiles == 2);
+	REQUIRE(stats.sharedTiles == 1);
+	REQUIRE(stats.distinctTiles == 3);
+	REQUIRE(stats.uniqueBytes == 2 * original.GetTile(0)->GetByteSize());
+	REQUIRE(original.GetSharingStats().sharedTiles == 1);
+	REQUIRE(original.GetSharingStats().uniqueTiles == 1);
+	REQUIRE(Tile::GetPeakInstanceCount() == before + 2);
+
+	const auto total = CoWCounters::Get();
+	REQUIRE(total.unshareCopies == 3);
+	REQUIRE(total.bytesCopied == 2 * sizeof(Tile) + original.GetTile(0)->GetByteSize());
+
+	// временные тайлы поднимают пик, но не число живых тайлов
+	{
+		Image temporary({ 32, 16 }, 0x10);
+		temporary.FillRect({ 0, 0 }, { 31, 15 }, 0x40);
+		temporary.SetPixel({ 0, 0 }, 0x50);
+	}
+	REQUIRE(Tile::GetInstanceCount() == before + 2);
+	REQUIRE(Tile::GetPeakInstanceCount() > before + 2);
+
+	// выключенные счётчики не меняются
+	CoWCounters::Enable(false);
+	copy.SetPixel({ 17, 1 }, 0x30);
+	REQUIRE(copy.GetSharingStats().copies.unshareCopies == 2);
+	REQUIRE(CoWCounters::Get().unshareCopies == 3);
+}
+
+TEST_CASE("span fill is clipped and crosses tiles")
+{
+	TestImage img({ 20, 4 }, 0);
+	img.FillSpan(2, -5, 17, 0xAA);
+
+	REQUIRE(img.GetPixel({ 0, 2 }) == 0xAA);
+	REQUIRE(img.GetPixel({ 17, 2 }) == 0xAA);
+	REQUIRE(img.GetPixel({ 18, 2 }) == 0);
+	REQUIRE(img.GetPixel({ 5, 1 }) == 0);
+	REQUIRE(img.GetPixel({ 5, 3 }) == 0);
+
+	img.FillSpan(-1, 0, 19, 0xBB);
+	img.FillSpan(1, 19, 30, 0xCC);
+	REQUIRE(img.GetPixel({ 19, 1 }) == 0xCC);
+	REQUIRE(img.GetPixel({ 18, 1 }) == 0);
+}
+
+TEST_CASE("rect fill replaces covered tiles without copying them")
+{
+	TestImage img({ 24, 24 }, 0);
+	auto& tiles = img.Tiles();
+	const int before = Tile::GetInstanceCount();
+
+	img.FillRect({ 4, 4 }, { 19, 19 }, 0x55);
+	REQUIRE(img.GetPixel({ 3, 4 }) == 0);
+	REQUIRE(img.GetPixel({ 4, 4 }) == 0x55);
+	REQUIRE(img.GetPixel({ 19, 19 }) == 0x55);
+	REQUIRE(img.GetPixel({ 20, 19 }) == 0);
+
+	// центральный тайл покрыт полностью, 8 соседних - частично,
+	// общий тайл больше никому не нужен
+	REQUIRE(tiles[4].GetInstanceCount() == 1);
+	REQUIRE(tiles[4]->GetPixel({ 0, 0 }) == 0x55);
+	REQUIRE(Tile::GetInstanceCount() == before + 8);
+}
+
+TEST_CASE("lines and filled circles drawn with spans")
+{
+	Image img({ 16, 16 }, 0);
+	DrawLine(img, { 1, 2 }, { 14, 5 }, 0xFF);
+	REQUIRE(img.GetPixel({ 1, 2 }) == 0xFF);
+	REQUIRE(img.GetPixel({ 14, 5 }) == 0xFF);
+	for (int x = 1; x <= 14; ++x)
+	{
+		int painted = 0;
+		for (int y = 0; y < 16; ++y)
+		{
+			painted += img.GetPixel({ x, y }) == 0xFF;
+		}
+		REQUIRE(painted == 1);
+	}
+
+	Image circle({ 15, 12 }, 0);
+	FillCircle(circle, { 7, 5 }, 4, 0xFF0000);
+	REQUIRE(circle.GetPixel({ 7, 1 }) == 0xFF0000);
+	REQUIRE(circle.GetPixel({ 3, 5 }) == 0xFF0000);
+	REQUIRE(circle.GetPixel({ 11, 5 }) == 0xFF0000);
+	REQUIRE(circle.GetPixel({ 7, 0 }) == 0);
+	REQUIRE(circle.GetPixel({ 2, 5 }) == 0);
+
+	Image outline({ 15, 12 }, 0);
+	DrawCircle(outline, { 7, 5 }, 4, 0xFFFFFF);
+	REQUIRE(outline.GetPixel({ 7, 1 }) == 0xFFFFFF);
+	REQUIRE(outline.GetPixel({ 3, 5 }) == 0xFFFFFF);
+	REQUIRE(outline.GetPixel({ 7, 5 }) == 0);
+}
+
+TEST_CASE("solid tile expands only when a second color appears")
+{
+	Tile tile{ 0x10 };
+	REQUIRE(tile.IsSolid());
+	const size_t solidBytes = tile.GetByteSize();
+
+	tile.SetPixel({ 1, 1 }, 0x10);
+	tile.FillRect({ 0, 0 }, 4, 4, 0x10);
+	REQUIRE(tile.IsSolid());
+
+	tile.SetPixel({ 2, 3 }, 0x20);
+	REQUIRE_FALSE(tile.IsSolid());
+	REQUIRE(tile.GetByteSize() >= solidBytes + Tile::SIZE * Tile::SIZE * sizeof(uint32_t));
+	REQUIRE(tile.GetPixel({ 2, 3 }) == 0x20);
+	REQUIRE(tile.GetPixel({ 7, 7 }) == 0x10);
+
+	REQUIRE_FALSE(tile.TryCollapse());
+	tile.SetPixel({ 2, 3 }, 0x10);
+	REQUIRE(tile.TryCollapse());
+	REQUIRE(tile.IsSolid());
+	REQUIRE(tile.GetPixel({ 2, 3 }) == 0x10);
+
+	tile.FillRect({ 0, 0 }, Tile::SIZE, Tile::SIZE, 0x30);
+	REQUIRE(tile.IsSolid());
+	REQUIRE(tile.GetPixel({ 5, 5 }) == 0x30);
+}
+
+TEST_CASE("same color fill keeps solid tiles shared")
+{
+	TestImage img({ 16, 16 }, 0x40);
+	auto& tiles = img.Tiles();
+
+	img.FillSpan(3, 0, 11, 0x40);
+	img.FillRect({ 1, 1 }, { 14, 5 }, 0x40);
+	for (auto& t : tiles)
+	{
+		REQUIRE(t.GetInstanceCount() == 4);
+	}
+}
+
+TEST_CASE("collapse returns repainted tiles to a single value")
+{
+	TestImage img({ 16, 8 }, 0);
+	auto& tiles = img.Tiles();
+	img.SetPixel({ 1, 1 }, 0x70);
+	img.SetPixel({ 9, 1 }, 0x70);
+	REQUIRE_FALSE(tiles[0]->IsSolid());
+
+	TestImage copy = img;
+	img.SetPixel({ 1, 1 }, 0);
+	img.FillRect({ 8, 0 }, { 15, 7 }, 0x70);
+
+	// второй тайл уже заполнен целиком, сворачивать нечего
+	REQUIRE(img.CollapseSolidTiles() == 1);
+	REQUIRE(tiles[0]->IsSolid());
+	REQUIRE(tiles[1]->IsSolid());
+	REQUIRE(img.GetPixel({ 9, 1 }) == 0x70);
+	REQUIRE(copy.GetPixel({ 1, 1 }) == 0x70);
+}
+
+TEST_CASE("compact re-shares identical tiles across images")
+{
+	TestImage first({ 16, 8 }, 0);
+	TestImage second({ 16, 8 }, 0);
+	for (auto* img : { &first, &second })
+	{
+		img->SetPixel({ 2, 2 }, 0xAB);
+		img->SetPixel({ 10, 2 }, 0xAB);
+	}
+	REQUIRE_FALSE(first.Tiles()[0].IsSharedWith(second.Tiles()[0]));
+
+	TileInterner interner;
+	const int before = Tile::GetInstanceCount();
+	REQUIRE(first.Compact(interner) > 0);
+	// два одинаковых тайла внутри первого изображения
+	REQUIRE(first.Tiles()[0].IsSharedWith(first.Tiles()[1]));
+	REQUIRE(Tile::GetInstanceCount() == before - 1);
+
+	const size_t reclaimed = second.Compact(interner);
+	REQUIRE(reclaimed == 2 * first.Tiles()[0]->GetByteSize());
+	REQUIRE(second.Tiles()[1].IsSharedWith(first.Tiles()[0]));
+	REQUIRE(Tile::GetInstanceCount() == before - 3);
+	REQUIRE(interner.GetSize() == 1);
+
+	// запись после сжатия снова отделяет тайл
+	second.SetPixel({ 10, 2 }, 0);
+	REQUIRE(first.GetPixel({ 10, 2 }) == 0xAB);
+	REQUIRE(second.GetPixel({ 2, 2 }) == 0xAB);
+
+	interner.Clear();
+	REQUIRE(second.Compact(interner) == 0);
+}
+
+TEST_CASE("interner does not own tiles, so writes after compact do not copy")
+{
+	TestImage img({ 16, 8 }, 0);
+	img.SetPixel({ 2, 2 }, 0xAB);
+	ImageHistory history{ img };
+
+	TileInterner interner;
+	TestImage other({ 16, 8 }, 0);
+	other.SetPixel({ 2, 2 }, 0xAB);
+	other.Compact(interner);
+	img.Compact(interner);
+	REQUIRE(img.Tiles()[0].IsSharedWith(other.Tiles()[0]));
+	// тот же тайл под другим экземпляром - не новая версия
+	REQUIRE_FALSE(history.Commit(img));
+
+	other = TestImage({ 16, 8 }, 0);
+	REQUIRE(img.Tiles()[0].GetInstanceCount() == 1);
+	CoWCounters::Enable();
+	CoWCounters::Reset();
+	img.SetPixel({ 3, 2 }, 0xCD);
+	REQUIRE(CoWCounters::Get().unshareCopies == 0);
+	CoWCounters::Enable(false);
+
+	// тайл изменён на месте: прежнее содержимое больше не находится
+	TestImage again({ 16, 8 }, 0);
+	again.SetPixel({ 2, 2 }, 0xAB);
+	again.Compact(interner);
+	REQUIRE_FALSE(again.Tiles()[0].IsSharedWith(img.Tiles()[0]));
+	REQUIRE(img.GetPixel({ 3, 2 }) == 0xCD);
+	REQUIRE(again.GetPixel({ 3, 2 }) == 0);
+}
+
+TEST_CASE("solid and expanded tiles of one color are interned together")
+{
+	Tile expanded{ 5 };
+	expanded.SetPixel({ 0, 0 }, 6);
+	expanded.SetPixel({ 0, 0 }, 5);
+	REQUIRE_FALSE(expanded.IsSolid());
+	REQUIRE(expanded == Tile{ 5 });
+	REQUIRE(expanded.GetContentHash() == Tile{ 5 }.GetContentHash());
+	REQUIRE_FALSE(expanded == Tile{ 6 });
+
+	TileInterner interner;
+	CoW<Tile> solid{ 5u };
+	CoW<Tile> copy{ expanded };
+	interner.Intern(solid);
+	interner.Intern(copy);
+	REQUIRE(copy.IsSharedWith(solid));
+
+	solid = CoW<Tile>{ 7u };
+	copy = CoW<Tile>{ 7u };
+	interner.Prune();
+	REQUIRE(interner.GetSize() == 0);
+}
+
+TEST_CASE("thread pool visits every index once and rethrows")
+{
+	ThreadPool pool{ 4 };
+	REQUIRE(pool.GetThreadCount() == 4);
+
+	std::vector<std::atomic<int>> visits(1000);
+	pool.ParallelFor(visits.size(), [&visits](size_t i) { ++visits[i]; });
+	for (auto& v : visits)
+	{
+		REQUIRE(v == 1);
+	}
+
+	REQUIRE_THROWS_AS(pool.ParallelFor(100, [](size_t i) {
+		if (i == 42)
+		{
+			throw std::runtime_error("fail");
+		}
+	}), std::runtime_error);
+	pool.ParallelFor(0, [](size_t) { FAIL("must not be called"); });
+}
+
+TEST_CASE("bounded queue blocks the producer and drains after close")
+{
+	BoundedQueue<int> queue{ 2 };
+	std::thread producer{ [&queue] {
+		for (int i = 0; i < 100; ++i)
+		{
+			queue.Push(i);
+		}
+		queue.Close();
+	} };
+
+	std::vector<int> received;
+	while (auto value = queue.Pop())
+	{
+		received.push_back(*value);
+	}
+	producer.join();
+
+	std::vector<int> expected(100);
+	std::iota(expected.begin(), expected.end(), 0);
+	REQUIRE(received == expected);
+
+	const auto stats = queue.GetStats();
+	REQUIRE(stats.capacity == 2);
+	REQUIRE(stats.pushed == 100);
+	REQUIRE(stats.maxSize <= 2);
+	REQUIRE(stats.averageSize >= 0);
+	REQUIRE(stats.averageSize <= 2);
+	REQUIRE_THROWS_AS(queue.Push(1), std::logic_error);
+	REQUIRE_FALSE(queue.Pop());
+}
+
+TEST_CASE("batched drawing matches serial drawing")
+{
+	const ImageSize size{ 61, 47 };
+	Image serial(size, 0x202020);
+	Image batched(size, 0x202020);
+
+	const std::vector<Shape> shapes{
+		FilledCircleShape{ { 30, 20 }, 18, 0xFF0000 },
+		LineShape{ { -5, 3 }, { 70, 40 }, 0x00FF00 },
+		CircleShape{ { 30, 20 }, 18, 0xFFFFFF },
+		LineShape{ { 10, 46 }, { 14, -3 }, 0x0000FF },
+		FilledCircleShape{ { 55, 40 }, 9, 0x00FFFF },
+		CircleShape{ { 0, 0 }, 25, 0xFF00FF },
+	};
+
+	DrawBatch(batched, shapes);
+
+	FillCircle(serial, { 30, 20 }, 18, 0xFF0000);
+	DrawLine(serial, { -5, 3 }, { 70, 40 }, 0x00FF00);
+	DrawCircle(serial, { 30, 20 }, 18, 0xFFFFFF);
+	DrawLine(serial, { 10, 46 }, { 14, -3 }, 0x0000FF);
+	FillCircle(serial, { 55, 40 }, 9, 0x00FFFF);
+	DrawCircle(serial, { 0, 0 }, 25, 0xFF00FF);
+
+	RequireSamePixels(serial, batched);
+}
+
+TEST_CASE("batched drawing leaves untouched tiles shared")
+{
+	TestImage img({ 32, 32 }, 0);
+	auto& tiles = img.Tiles();
+	DrawBatch(img, { LineShape{ { 0, 0 }, { 7, 0 }, 0xFF } });
+
+	REQUIRE(tiles[0].GetInstanceCount() == 1);
+	REQUIRE(tiles[1].GetInstanceCount() == 15);
+	REQUIRE(img.GetPixel({ 7, 0 }) == 0xFF);
+	REQUIRE(img.GetPixel({ 8, 0 }) == 0);
+}
+
+TEST_CASE("blend of a single pixel")
+{
+	REQUIRE(BlendPixel(0xFF123456, 0xFFABCDEF) == 0xFFABCDEF);
+	REQUIRE(BlendPixel(0xFF123456, 0x00ABCDEF) == 0xFF123456);
+	REQUIRE(BlendPixel(0xFF000000, 0x80FFFFFF) == 0xFF808080);
+	REQUIRE(BlendPixel(0x00000000, 0x80FF0000) == 0x80800000);
+}
+
+TEST_CASE("every SIMD level matches the scalar kernels")
+{
+	std::mt19937 rng{ 1 };
+	const auto& scalar = GetPixelKernels(SimdLevel::Scalar);
+
+	for (auto level : { SimdLevel::Sse2, SimdLevel::Avx2 })
+	{
+		const auto& kernels = GetPixelKernels(level);
+		REQUIRE(kernels.level <= GetSupportedSimdLevel());
+
+		// длины с «хвостами», которые не кратны ширине регистра
+		for (size_t count : { 0, 1, 3, 4, 7, 8, 9, 64, 131 })
+		{
+			std::vector<uint32_t> src(count);
+			std::vector<uint32_t> dst(count);
+			for (size_t i = 0; i < count; ++i)
+			{
+				src[i] = static_cast<uint32_t>(rng());
+				dst[i] = i % 5 == 0 ? 0x11223344 : static_cast<uint32_t>(rng());
+			}
+			if (count > 2)
+			{
+				src[0] |= 0xFF000000;
+				src[1] &= 0x00FFFFFF;
+			}
+
+			auto expected = dst;
+			auto actual = dst;
+			scalar.blend(expected.data(), src.data(), count);
+			kernels.blend(actual.data(), src.data(), count);
+			REQUIRE(actual == expected);
+
+			expected = dst;
+			actual = dst;
+			scalar.replace(expected.data(), count, 0x11223344, 0xCAFE);
+			kernels.replace(actual.data(), count, 0x11223344, 0xCAFE);
+			REQUIRE(actual == expected);
+
+			kernels.fill(actual.data(), count, 0x77);
+			REQUIRE(std::count(actual.begin(), actual.end(), 0x77u) == static_cast<std::ptrdiff_t>(count));
+			kernels.copy(actual.data(), src.data(), count);
+			REQUIRE(actual == src);
+
+			// уменьшение читает по 2 * count + 2 пикселя из каждой строки
+			std::vector<std::vector<uint32_t>> rows(4, std::vector<uint32_t>(2 * count + 2));
+			for (auto& row : rows)
+			{
+				std::generate(row.begin(), row.end(), [&rng] { return static_cast<uint32_t>(rng()); });
+			}
+			const uint32_t* rowPointers[4]{ rows[0].data(), rows[1].data(), rows[2].data(), rows[3].data() };
+			scalar.downsampleBox(expected.data(), rows[0].data(), rows[1].data(), count);
+			kernels.downsampleBox(actual.data(), rows[0].data(), rows[1].data(), count);
+			REQUIRE(actual == expected);
+			scalar.downsampleBilinear(expected.data(), rowPointers, count);
+			kernels.downsampleBilinear(actual.data(), rowPointers, count);
+			REQUIRE(actual == expected);
+
+			// одинаковые пиксели подряд добавляются отдельной веткой
+			auto uniform = src;
+			std::fill_n(uniform.begin(), std::min<size_t>(count, 9), 0x80402010u);
+			std::vector<uint32_t> expectedBins(4 * 256);
+			std::vector<uint32_t> actualBins(4 * 256);
+			scalar.histogram(expectedBins.data(), uniform.data(), count);
+			kernels.histogram(actualBins.data(), uniform.data(), count);
+			REQUIRE(actualBins == expectedBins);
+		}
+	}
+}
+
+TEST_CASE("blit and blend images with an offset")
+{
+	Image dst({ 20, 20 }, 0xFF000000);
+	Image src({ 10, 10 }, 0x80FFFFFF);
+	src.FillRect({ 0, 0 }, { 9, 1 }, 0x00FFFFFF);
+
+	dst.Blend(src, { 13, -2 });
+	REQUIRE(dst.GetPixel({ 12, 0 }) == 0xFF000000);
+	REQUIRE(dst.GetPixel({ 13, 0 }) == 0xFF808080);
+	REQUIRE(dst.GetPixel({ 19, 7 }) == 0xFF808080);
+	REQUIRE(dst.GetPixel({ 13, 8 }) == 0xFF000000);
+
+	dst.Blit(src, { -5, 15 });
+	REQUIRE(dst.GetPixel({ 0, 15 }) == 0x00FFFFFF);
+	REQUIRE(dst.GetPixel({ 4, 19 }) == 0x80FFFFFF);
+	REQUIRE(dst.GetPixel({ 5, 19 }) == 0xFF000000);
+
+	// наложение на себя работает с исходными пикселями
+	Image self = MakeGradient({ 12, 12 });
+	const Image before = self;
+	self.Blit(self, { 3, 3 });
+	REQUIRE(self.GetPixel({ 3, 3 }) == before.GetPixel({ 0, 0 }));
+	REQUIRE(self.GetPixel({ 11, 11 }) == before.GetPixel({ 8, 8 }));
+}
+
+TEST_CASE("fused pipeline matches separate passes")
+{
+	Image src = MakeGradient({ 37, 29 });
+	src.FillRect({ 0, 16 }, { 36, 28 }, 0xFF102030);
+	Image overlay({ 11, 9 }, 0x80FFFFFF);
+	overlay.FillRect({ 0, 0 }, { 10, 1 }, 0x00FFFFFF);
+	const Image before = src;
+
+	ImageExpr expr{ src };
+	expr.ReplaceColor(0xFF102030, 0xFF405060)
+		.Invert()
+		.Blend(overlay, { 30, 12 })
+		.Blit(overlay, { -3, -2 })
+		.Threshold(100, 0xFF000000, 0xFFFFFFFF);
+	REQUIRE(expr.GetStepCount() == 5);
+
+	Image expected = src;
+	expected.ReplaceColor(0xFF102030, 0xFF405060);
+	expected.ForEachTile([](TilePixels<uint32_t> tile) {
+		for (int y = 0; y < tile.size.height; ++y)
+		{
+			for (int x = 0; x < tile.size.width; ++x)
+			{
+				tile.GetRow(y)[x] ^= 0x00FFFFFF;
+			}
+		}
+	});
+	expected.Blend(overlay, { 30, 12 });
+	expected.Blit(overlay, { -3, -2 });
+	for (int y = 0; y < 29; ++y)
+	{
+		for (int x = 0; x < 37; ++x)
+		{
+			const uint32_t color = expected.GetPixel({ x, y });
+			const uint32_t luma = ((color >> 16 & 0xFF) * 77 + (color >> 8 & 0xFF) * 150 + (color & 0xFF) * 29) >> 8;
+			expected.SetPixel({ x, y }, luma >= 100 ? 0xFFFFFFFF : 0xFF000000);
+		}
+	}
+
+	RequireSamePixels(expected, expr.Evaluate());
+	ThreadPool pool{ 4 };
+	RequireSamePixels(expected, expr.Evaluate(pool));
+	// источник не меняется
+	REQUIRE(src.GetChangedTiles(before).empty());
+}
+
+TEST_CASE("fused pipeline keeps solid tiles solid and shared")
+{
+	Image img({ 64, 64 }, 0xFFFF0000);
+	img.SetPixel({ 5, 5 }, 0xFF00FF00);
+
+	const Image recolored = ImageExpr{ img }.ReplaceColor(0xFFFF0000, 0xFF0000FF).Evaluate();
+	REQUIRE(recolored.GetPixel({ 0, 0 }) == 0xFF0000FF);
+	REQUIRE(recolored.GetPixel({ 5, 5 }) == 0xFF00FF00);
+	// одноцветные тайлы нового цвета снова общие
+	for (size_t index = 2; index < recolored.GetTileCount(); ++index)
+	{
+		REQUIRE(recolored.GetTile(index).IsSharedWith(recolored.GetTile(1)));
+	}
+
+	// шаги не меняют ни одноцветные, ни развёрнутые тайлы - все остаются общими
+	// с источником
+	const Image same = ImageExpr{ img }.ReplaceColor(0xFF0000FF, 0xFFFFFFFF).Evaluate();
+	REQUIRE(same.GetChangedTiles(img).empty());
+	RequireSamePixels(img, same);
+
+	// развёрнутый тайл вне наложения и с неизменным содержимым тоже не копируется
+	const Image overlaid = ImageExpr{ img }.Invert().Invert().Blit(Image{ { 8, 8 }, 1 }, { 56, 56 }).Evaluate();
+	REQUIRE(overlaid.GetChangedTiles(img) == std::vector<size_t>{ 63 });
+}
+
+TEST_CASE("histogram counts solid and shared tiles by multiplicity")
+{
+	// края обрезаны, часть тайлов одноцветные, часть - одна общая копия
+	Image img = MakeGradient({ 45, 38 });
+	img.FillRect({ 0, 16 }, { 44, 31 }, 0x80FF0000);
+	for (size_t index = 13; index < 17; ++index)
+	{
+		img.SetTile(index, img.GetTile(1));
+	}
+
+	ImageHistogram expected;
+	expected.pixelCount = 45 * 38;
+	for (int y = 0; y < 38; ++y)
+	{
+		for (int x = 0; x < 45; ++x)
+		{
+			const uint32_t color = img.GetPixel({ x, y });
+			for (size_t channel = 0; channel < 4; ++channel)
+			{
+				++expected.bins[channel][color >> (8 * channel) & 0xFF];
+			}
+		}
+	}
+
+	ThreadPool pool{ 3 };
+	for (auto level : { SimdLevel::Scalar, SimdLevel::Avx2 })
+	{
+		UsePixelKernels(level);
+		const auto histogram = ComputeHistogram(img, pool);
+		REQUIRE(histogram.pixelCount == expected.pixelCount);
+		REQUIRE(histogram.bins == expected.bins);
+	}
+	UsePixelKernels(GetSupportedSimdLevel());
+	REQUIRE(ComputeHistogram(img).bins == expected.bins);
+}
+
+TEST_CASE("channel stats come from the histogram")
+{
+	Image img({ 10, 10 }, 0xFF000000);
+	img.FillRect({ 0, 0 }, { 9, 4 }, 0xFF204060);
+	img.SetPixel({ 9, 9 }, 0x10FF0000);
+
+	const auto stats = ComputeStats(img);
+	REQUIRE(stats.pixelCount == 100);
+	REQUIRE(stats[Channel::Red].min == 0);
+	REQUIRE(stats[Channel::Red].max == 0xFF);
+	REQUIRE(stats[Channel::Red].mean == Approx((50.0 * 0x20 + 0xFF) / 100));
+	REQUIRE(stats[Channel::Green].max == 0x40);
+	REQUIRE(stats[Channel::Blue].mean == Approx(50.0 * 0x60 / 100));
+	REQUIRE(stats[Channel::Alpha].min == 0x10);
+	REQUIRE(stats[Channel::Alpha].mean == Approx((99.0 * 0xFF + 0x10) / 100));
+}
+
+TEST_CASE("transparent blend and missing key keep tiles shared")
+{
+	TestImage img({ 16, 16 }, 0xFF000000);
+	auto& tiles = img.Tiles();
+	img.Blend(Image({ 16, 16 }, 0x00FFFFFF), { 0, 0 });
+	img.ReplaceColor(0x12345678, 0);
+	for (auto& t : tiles)
+	{
+		REQUIRE(t.GetInstanceCount() == 4);
+	}
+
+	img.SetPixel({ 1, 1 }, 0xAA);
+	img.SetPixel({ 9, 9 }, 0xAA);
+	img.ReplaceColor(0xFF000000, 0xBB);
+	REQUIRE(img.GetPixel({ 1, 1 }) == 0xAA);
+	REQUIRE(img.GetPixel({ 2, 1 }) == 0xBB);
+	REQUIRE(img.GetPixel({ 15, 0 }) == 0xBB);
+	REQUIRE(tiles[1]->IsSolid());
+}
+
+TEST_CASE("parallel writers on copies of one image")
+{
+	TestImage base({ 40, 40 }, 0x111111);
+	for (int i = 0; i < 40; ++i)
+	{
+		base.SetPixel({ i, 39 - i }, 0x222222);
+	}
+	const TestImage snapshot = base;
+	const int tilesBefore = Tile::GetInstanceCount();
+
+	for (int round = 0; round < 20; ++round)
+	{
+		std::vector<std::thread> writers;
+		std::atomic<int> mismatches{ 0 };
+		for (uint32_t t = 0; t < 8; ++t)
+		{
+			writers.emplace_back([&base, &mismatches, t] {
+				// копия в своём потоке: тайлы общие, пока поток не начнёт писать
+				Image mine = base;
+				for (int y = 0; y < 40; ++y)
+				{
+					for (int x = t % 2; x < 40; x += 2)
+					{
+						mine.SetPixel({ x, y }, t << 16 | static_cast<uint32_t>(x + y));
+					}
+				}
+				mine.FillRect({ 0, 0 }, { 3, 3 }, t);
+
+				for (int y = 0; y < 40; ++y)
+				{
+					for (int x = t % 2; x < 40; x += 2)
+					{
+						const uint32_t expected = x <= 3 && y <= 3 ? t : t << 16 | static_cast<uint32_t>(x + y);
+						mismatches += mine.GetPixel({ x, y }) != expected;
+					}
+				}
+			});
+		}
+		for (auto& writer : writers)
+		{
+			writer.join();
+		}
+
+		REQUIRE(mismatches == 0);
+		REQUIRE(Tile::GetInstanceCount() == tilesBefore);
+	}
+
+	RequireSamePixels(base, snapshot);
+}
+
+TEST_CASE("single-thread ownership policy keeps copy-on-write semantics")
+{
+	CoW<Tile, SingleThreadOwnership> first{ 1u };
+	CoW<Tile, SingleThreadOwnership> second = first;
+	second--->SetPixel({ 0, 0 }, 2);
+	REQUIRE(first->GetPixel({ 0, 0 }) == 1);
+	REQUIRE(second->GetPixel({ 0, 0 }) == 2);
+	REQUIRE(first.GetInstanceCount() == 1);
+}
+
+TEST_CASE("history records only changed tiles and walks between versions")
+{
+	Image img({ 32, 32 }, 0);
+	ImageHistory history{ img };
+	REQUIRE_FALSE(history.CanUndo());
+	REQUIRE_FALSE(history.Commit(img));
+
+	FillCircle(img, { 4, 4 }, 2, 0xFF);
+	REQUIRE(history.Commit(img));
+	const Image afterCircle = img;
+
+	img.SetPixel({ 30, 30 }, 0xEE);
+	REQUIRE(history.Commit(img));
+	REQUIRE(history.GetCurrentVersion() == 2);
+	REQUIRE(history.GetChangedTiles(1) == std::vector<size_t>{ 0 });
+	REQUIRE(history.GetChangedTiles(2) == std::vector<size_t>{ 15 });
+
+	img = history.Undo();
+	REQUIRE(img.GetPixel({ 30, 30 }) == 0);
+	REQUIRE(img.GetPixel({ 4, 4 }) == 0xFF);
+	RequireSamePixels(img, afterCircle);
+
+	img = history.JumpTo(0);
+	REQUIRE(img.GetPixel({ 4, 4 }) == 0);
+	REQUIRE(history.CanRedo());
+
+	img = history.Redo();
+	img = history.Redo();
+	REQUIRE(img.GetPixel({ 30, 30 }) == 0xEE);
+	REQUIRE_THROWS_AS(history.Redo(), std::logic_error);
+	REQUIRE_THROWS_AS(history.JumpTo(3), std::out_of_range);
+
+	// новая запись после отката отбрасывает ветку Redo
+	img = history.JumpTo(1);
+	img.SetPixel({ 8, 8 }, 0x11);
+	REQUIRE(history.Commit(img));
+	REQUIRE(history.GetNewestVersion() == 2);
+	REQUIRE(history.GetChangedTiles(2) == std::vector<size_t>{ 5 });
+}
+
+TEST_CASE("history memory follows changed tiles and respects the budget")
+{
+	Image img({ 256, 256 }, 0);
+	ImageHistory history{ img };
+
+	img.SetPixel({ 1, 1 }, 1);
+	history.Commit(img);
+	const size_t oneTile = history.GetByteSize();
+	REQUIRE(oneTile > 0);
+	// запись о версии не зависит от числа тайлов изображения (1024)
+	REQUIRE(oneTile < 1024);
+
+	img.SetPixel({ 100, 100 }, 2);
+	img.SetPixel({ 200, 200 }, 3);
+	history.Commit(img);
+	REQUIRE(history.GetByteSize() == 3 * oneTile);
+
+	history.SetByteBudget(2 * oneTile);
+	REQUIRE(history.GetOldestVersion() == 1);
+	REQUIRE(history.GetCurrentVersion() == 2);
+	REQUIRE(history.GetByteSize() == 2 * oneTile);
+
+	img = history.Undo();
+	REQUIRE_FALSE(history.CanUndo());
+	REQUIRE(img.GetPixel({ 1, 1 }) == 1);
+	REQUIRE(img.GetPixel({ 100, 100 }) == 0);
+
+	// вытеснять старые версии уже нельзя, уходит версия для Redo
+	history.SetByteBudget(0);
+	REQUIRE_FALSE(history.CanRedo());
+	REQUIRE(history.GetByteSize() == 0);
+}
+TEST_CASE("history of a mapped image records only edited tiles")
+{
+	const Image original = MakeGradient({ 64, 64 });
+	SaveImage(original, "test_history_map.ppm");
+
+	{
+		Image img = MapImage("test_history_map.ppm");
+		ImageHistory history{ img };
+		img.SetPixel({ 9, 9 }, 0xFF0000);
+		REQUIRE(history.Commit(img));
+		REQUIRE(history.GetChangedTiles(1) == std::vector<size_t>{ 9 });
+
+		// тайлы, прочитанные после снимка, общие с ним
+		std::as_const(img).ForEachTile([](const TilePixels<const uint32_t>&) {});
+		img.SetPixel({ 63, 63 }, 0xFF0000);
+		REQUIRE(history.Commit(img));
+		REQUIRE(history.GetChangedTiles(2) == std::vector<size_t>{ 63 });
+
+		img = history.Undo();
+		REQUIRE(img.GetPixel({ 63, 63 }) == original.GetPixel({ 63, 63 }));
+		REQUIRE(img.GetPixel({ 9, 9 }) == 0xFF0000);
+	}
+	std::remove("test_history_map.ppm");
+}
+
+TEST_CASE("writes mark tiles dirty until cleared")
+{
+	Image img({ 40, 24 }, 0);
+	REQUIRE(img.GetDirtyTiles().empty());
+
+	img.SetPixel({ 9, 1 }, 1);
+	img.FillSpan(17, 30, 39, 2);
+	// закраска тайлов тем же цветом не отделяет их и не отмечает
+	img.FillRect({ 0, 0 }, { 7, 7 }, 0);
+	REQUIRE(img.GetDirtyTiles() == std::vector<size_t>{ 1, 13, 14 });
+
+	img.ClearDirtyTiles();
+	REQUIRE_FALSE(img.IsTileDirty(1));
+
+	// копия наследует отметки, но дальше отмечает свои записи
+	img.FillRect({ 0, 8 }, { 7, 15 }, 3);
+	Image copy = img;
+	copy.SetPixel({ 39, 0 }, 4);
+	REQUIRE(img.GetDirtyTiles() == std::vector<size_t>{ 5 });
+	REQUIRE(copy.GetDirtyTiles() == std::vector<size_t>{ 4, 5 });
+}
+
+TEST_CASE("tiled file round trip and incremental save")
+{
+	Image img = MakeGradient({ 50, 30 });
+	img.FillRect({ 0, 0 }, { 15, 7 }, 0xABCDEF);
+	SaveTiled(img, "test.tiles");
+	REQUIRE(img.GetDirtyTiles().empty());
+
+	RequireSamePixels(LoadTiled("test.tiles"), img);
+
+	std::ifstream before{ "test.tiles", std::ios::binary };
+	const std::string oldBytes{ std::istreambuf_iterator<char>(before), {} };
+	before.close();
+
+	// тайлы: развёрнутый, одноцветный -> развёрнутый, развёрнутый -> одноцветный
+	img.SetPixel({ 49, 29 }, 1);
+	img.SetPixel({ 3, 3 }, 2);
+	img.FillRect({ 16, 8 }, { 23, 15 }, 3);
+	SaveTiledIncremental(img, "test.tiles");
+	REQUIRE(img.GetDirtyTiles().empty());
+
+	std::ifstream after{ "test.tiles", std::ios::binary };
+	const std::string newBytes{ std::istreambuf_iterator<char>(after), {} };
+	after.close();
+
+	// дописан один новый участок пикселей, остальное изменено на месте
+	REQUIRE(newBytes.size() == oldBytes.size() + tiled::PAYLOAD_SIZE<Tile::SIZE>);
+	size_t changed = 0;
+	for (size_t i = 0; i < oldBytes.size(); ++i)
+	{
+		changed += oldBytes[i] != newBytes[i];
+	}
+	REQUIRE(changed <= 3 * tiled::INDEX_ENTRY_SIZE + 4);
+
+	Image loaded = LoadTiled("test.tiles");
+	RequireSamePixels(loaded, img);
+
+	// изображение, загруженное из файла, сохраняется в него же
+	loaded.SetPixel({ 20, 20 }, 4);
+	SaveTiledIncremental(loaded, "test.tiles");
+	RequireSamePixels(LoadTiled("test.tiles"), loaded);
+
+	Image other({ 51, 30 }, 0);
+	REQUIRE_THROWS_AS(SaveTiledIncremental(other, "test.tiles"), std::runtime_error);
+	std::remove("test.tiles");
+	REQUIRE_THROWS_AS(SaveTiledIncremental(img, "test.tiles"), std::runtime_error);
+	REQUIRE_THROWS_AS(LoadTiled("test.tiles"), std::runtime_error);
+}
+
+TEST_CASE("tiled image is saved over the file it was loaded from")
+{
+	Image original = MakeGradient({ 64, 40 });
+	original.FillRect({ 0, 0 }, { 31, 15 }, 0xABCDEF);
+	SaveTiled(original, "test_self.tiles");
+
+	{
+		Image loaded = LoadTiled("test_self.tiles");
+		const Image copy = loaded;
+		loaded.SetPixel({ 40, 30 }, 1);
+		SaveTiled(loaded, "test_self.tiles");
+		REQUIRE_FALSE(loaded.IsBackedBy("test_self.tiles"));
+
+		RequireSamePixels(LoadTiled("test_self.tiles"), loaded);
+		RequireSamePixels(copy, original);
+	}
+
+	// дописанные и перезаписанные на месте тайлы не видны копиям, а индекс
+	// источника после сохранения совпадает с файлом
+	{
+		Image loaded = LoadTiled("test_self.tiles");
+		const Image copy = loaded;
+		loaded.SetPixel({ 3, 3 }, 2);
+		loaded.SetPixel({ 50, 30 }, 3);
+		SaveTiledIncremental(loaded, "test_self.tiles");
+		REQUIRE(loaded.IsBackedBy("test_self.tiles"));
+
+		RequireSamePixels(LoadTiled("test_self.tiles"), loaded);
+		REQUIRE(copy.GetPixel({ 3, 3 }) == 0xABCDEF);
+		REQUIRE(copy.GetPixel({ 50, 30 }) == original.GetPixel({ 50, 30 }));
+		REQUIRE(copy.GetPixel({ 40, 30 }) == 1);
+	}
+	std::remove("test_self.tiles");
+}
+
+TEMPLATE_TEST_CASE_SIG("every tile size draws and stores the same pixels", "", ((unsigned N), N), 16, 32, 64)
+{
+	using SizedImage = BasicImage<N>;
+	const ImageSize size{ 150, 90 };
+	Image reference = MakeGradient(size);
+	SizedImage img = MakeGradient<SizedImage>(size);
+	REQUIRE(img.GetTileGridSize().width == (150 + static_cast<int>(N) - 1) / static_cast<int>(N));
+
+	const std::vector<Shape> shapes{
+		LineShape{ { -5, 3 }, { 160, 80 }, 0xFF0000 },
+		FilledCircleShape{ { 70, 40 }, 33, 0x00FF00 },
+		CircleShape{ { 20, 70 }, 25, 0x0000FF },
+	};
+	DrawBatch(reference, shapes);
+	DrawLine(img, { -5, 3 }, { 160, 80 }, 0xFF0000);
+	FillCircle(img, { 70, 40 }, 33, 0x00FF00);
+	DrawCircle(img, { 20, 70 }, 25, 0x0000FF);
+	RequireSamePixels(reference, img);
+
+	SizedImage batched = MakeGradient<SizedImage>(size);
+	DrawBatch(batched, shapes);
+	RequireSamePixels(img, batched);
+
+	SaveImage(img, "test_sized.ppm");
+	RequireSamePixels(ImportImage<SizedImage>("test_sized.ppm"), reference);
+	RequireSamePixels(MapImage<SizedImage>("test_sized.ppm"), reference);
+	std::remove("test_sized.ppm");
+
+	// контейнер с тайлами помнит их размер
+	SaveTiled(img, "test_sized.tiles");
+	RequireSamePixels(LoadTiled<SizedImage>("test_sized.tiles"), reference);
+	REQUIRE_THROWS_AS(LoadTiled("test_sized.tiles"), std::runtime_error);
+	std::remove("test_sized.tiles");
+
+	BasicImageHistory<N> history{ img };
+	img.SetPixel({ 0, 0 }, 1);
+	REQUIRE(history.Commit(img));
+	REQUIRE(history.Undo().GetPixel({ 0, 0 }) == reference.GetPixel({ 0, 0 }));
+}
+
+TEST_CASE("polygon fill covers pixel centres inside the contour")
+{
+	Image img({ 16, 16 }, 0);
+	FillPolygon(img, { { 2, 3 }, { 10, 3 }, { 10, 9 }, { 2, 9 } }, 1);
+	Image rect({ 16, 16 }, 0);
+	rect.FillRect({ 2, 3 }, { 9, 8 }, 1);
+	RequireSamePixels(img, rect);
+
+	// два треугольника с общей диагональю: без щелей и без перекрытия
+	Image halves({ 16, 16 }, 0);
+	FillTriangle(halves, { 2, 3 }, { 10, 3 }, { 10, 9 }, 1);
+	FillTriangle(halves, { 2, 3 }, { 10, 9 }, { 2, 9 }, 1);
+	RequireSamePixels(halves, rect);
+
+	// пентаграмма: центр пуст по правилу чётности и закрашен по ненулевому
+	const std::vector<Point> star{ { 20, 0 }, { 32, 38 }, { 0, 14 }, { 40, 14 }, { 8, 38 } };
+	Image evenOdd({ 41, 41 }, 0);
+	Image nonZero({ 41, 41 }, 0);
+	FillPolygon(evenOdd, star, 1, FillRule::EvenOdd);
+	FillPolygon(nonZero, star, 1, FillRule::NonZero);
+	REQUIRE(evenOdd.GetPixel({ 20, 20 }) == 0);
+	REQUIRE(nonZero.GetPixel({ 20, 20 }) == 1);
+	REQUIRE(evenOdd.GetPixel({ 20, 8 }) == 1);
+	REQUIRE(nonZero.GetPixel({ 20, 8 }) == 1);
+
+	// вырожденные и полностью невидимые многоугольники ничего не пишут
+	const int tiles = Tile::GetInstanceCount();
+	FillPolygon(img, {}, 2);
+	FillPolygon(img, { { 1, 1 }, { 9, 1 } }, 2);
+	FillPolygon(img, { { -50, -50 }, { -10, -50 }, { -30, -5 } }, 2);
+	REQUIRE(Tile::GetInstanceCount() == tiles);
+	REQUIRE_THROWS_AS(FillPolygon(img, { { 0, 0 }, { 1 << 30, 0 }, { 0, 5 } }, 2), std::out_of_range);
+}
+
+TEST_CASE("polygon fill matches per-pixel winding for random contours")
+{
+	std::mt19937 rng{ 7 };
+	std::uniform_int_distribution<int> coord{ -10, 50 };
+	const ImageSize size{ 41, 37 };
+
+	for (int iteration = 0; iteration < 200; ++iteration)
+	{
+		std::vector<Point> vertices(3 + iteration % 7);
+		for (auto& v : vertices)
+		{
+			v = { coord(rng), coord(rng) };
+		}
+		const auto rule = iteration % 2 ? FillRule::NonZero : FillRule::EvenOdd;
+
+		Image img(size, 0);
+		FillPolygon(img, vertices, 1, rule);
+
+		Image batched(size, 0);
+		DrawBatch(batched, { PolygonShape{ vertices, 1, rule } });
+		RequireSamePixels(img, batched);
+
+		for (int y = 0; y < size.height; ++y)
+		{
+			for (int x = 0; x < size.width; ++x)
+			{
+				// ребро пересекает центр строки левее центра пикселя или прямо в нём:
+				// a.x + (y + 0.5 - a.y) * dx / dy <= x + 0.5, домножено на 2 * dy
+				int winding = 0;
+				int crossings = 0;
+				for (size_t i = 0; i < vertices.size(); ++i)
+				{
+					Point a = vertices[i];
+					Point b = vertices[(i + 1) % vertices.size()];
+					if (a.y == b.y) continue;
+					const int direction = a.y < b.y ? 1 : -1;
+					if (a.y > b.y) std::swap(a, b);
+					if (y < a.y || y >= b.y) continue;
+
+					const int dx = b.x - a.x;
+					const int dy = b.y - a.y;
+					if (2 * dy * (a.x - x) + (2 * (y - a.y) + 1) * dx - dy <= 0)
+					{
+						winding += direction;
+						++crossings;
+					}
+				}
+				const bool inside = rule == FillRule::EvenOdd ? crossings % 2 == 1 : winding != 0;
+				REQUIRE(img.GetPixel({ x, y }) == (inside ? 1u : 0u));
+			}
+		}
+	}
+}
+TEST_CASE("blend pixel mixes by the alpha of the colour")
+{
+	Image img({ 16, 8 }, 0xFF000000);
+	Image copy = img;
+	img.BlendPixel({ 3, 3 }, 0x00FFFFFF);
+	REQUIRE(img.GetTile(0).IsSharedWith(copy.GetTile(0)));
+
+	img.BlendPixel({ 3, 3 }, 0xFF123456);
+	REQUIRE(img.GetPixel({ 3, 3 }) == 0xFF123456);
+	img.BlendPixel({ 12, 3 }, 0x80FF0000);
+	REQUIRE(img.GetPixel({ 12, 3 }) == BlendPixel(0xFF000000, 0x80FF0000));
+	img.BlendPixel({ -1, 3 }, 0xFFFFFFFF);
+}
+
+TEST_CASE("anti-aliased lines split coverage between neighbour pixels")
+{
+	// линии вдоль осей и диагонали покрывают пиксели целиком
+	for (Point to : { Point{ 30, 2 }, Point{ 2, 30 }, Point{ 30, 30 } })
+	{
+		Image aa({ 32, 32 }, 0);
+		Image solid({ 32, 32 }, 0);
+		DrawLineAA(aa, { 2, 2 }, to, 0xFF0000);
+		DrawLine(solid, { 2, 2 }, to, 0xFFFF0000);
+		RequireSamePixels(aa, solid);
+	}
+
+	// на пологой линии пара пикселей каждого столбца в сумме даёт полный цвет
+	Image img({ 32, 16 }, 0);
+	DrawLineAA(img, { 0, 1 }, { 30, 12 }, 0xFF0000);
+	for (int x = 0; x <= 30; ++x)
+	{
+		int sum = 0;
+		for (int y = 0; y < 16; ++y)
+		{
+			sum += static_cast<int>(img.GetPixel({ x, y }) >> 16 & 0xFF);
+		}
+		REQUIRE(std::abs(sum - 255) <= 1);
+	}
+}
+
+TEST_CASE("anti-aliased circle is symmetric and blends each pixel once")
+{
+	const Point c{ 20, 20 };
+	Image img({ 41, 41 }, 0);
+	DrawCircleAA(img, c, 10, 0xFF0000);
+
+	for (int dy = -12; dy <= 12; ++dy)
+	{
+		for (int dx = -12; dx <= 12; ++dx)
+		{
+			const uint32_t color = img.GetPixel({ c.x + dx, c.y + dy });
+			REQUIRE(color == img.GetPixel({ c.x - dx, c.y + dy }));
+			REQUIRE(color == img.GetPixel({ c.x + dx, c.y - dy }));
+			REQUIRE(color == img.GetPixel({ c.x + dy, c.y + dx }));
+		}
+	}
+
+	REQUIRE(img.GetPixel({ c.x, c.y - 10 }) == 0xFFFF0000);
+	REQUIRE(img.GetPixel({ c.x, c.y }) == 0);
+	// пиксель на диагонали (7, 7): y = sqrt(100 - 49), смешан ровно один раз
+	const auto alpha = static_cast<uint32_t>(std::lround((1 - (std::sqrt(51.0) - 7)) * 255));
+	REQUIRE(img.GetPixel({ c.x + 7, c.y + 7 }) == BlendPixel(0, alpha << 24 | 0xFF0000));
+}
+
+TEST_CASE("thick strokes honour width and caps")
+{
+	// квадратный торец толщиной 1 совпадает с обычной линией
+	Image thin({ 40, 20 }, 0);
+	Image line({ 40, 20 }, 0);
+	DrawThickLine(thin, { 10, 10 }, { 30, 10 }, 1, 1, LineCap::Square);
+	DrawLine(line, { 10, 10 }, { 30, 10 }, 1);
+	RequireSamePixels(thin, line);
+
+	Image butt({ 40, 20 }, 0);
+	Image square({ 40, 20 }, 0);
+	Image round({ 40, 20 }, 0);
+	DrawThickLine(butt, { 10, 10 }, { 30, 10 }, 6, 1, LineCap::Butt);
+	DrawThickLine(square, { 10, 10 }, { 30, 10 }, 6, 1, LineCap::Square);
+	DrawThickLine(round, { 10, 10 }, { 30, 10 }, 6, 1, LineCap::Round);
+
+	for (const Image* img : { &butt, &square, &round })
+	{
+		REQUIRE(img->GetPixel({ 20, 7 }) == 1);
+		REQUIRE(img->GetPixel({ 20, 12 }) == 1);
+		REQUIRE(img->GetPixel({ 20, 6 }) == 0);
+		REQUIRE(img->GetPixel({ 20, 13 }) == 0);
+	}
+	REQUIRE(butt.GetPixel({ 10, 10 }) == 1);
+	REQUIRE(butt.GetPixel({ 9, 10 }) == 0);
+	REQUIRE(square.GetPixel({ 7, 7 }) == 1);
+	REQUIRE(square.GetPixel({ 32, 12 }) == 1);
+	REQUIRE(square.GetPixel({ 33, 12 }) == 0);
+	REQUIRE(round.GetPixel({ 8, 10 }) == 1);
+	REQUIRE(round.GetPixel({ 7, 7 }) == 0);
+	REQUIRE(round.GetPixel({ 32, 10 }) == 1);
+
+	// кольцо: пиксели на окружности закрашены, центр и снаружи - нет
+	Image ring({ 60, 60 }, 0);
+	DrawThickCircle(ring, { 30, 30 }, 20, 4, 1);
+	for (int y = 0; y < 60; ++y)
+	{
+		for (int x = 0; x < 60; ++x)
+		{
+			const double distance = std::hypot(x - 30, y - 30);
+			if (distance <= 17.5 || distance >= 22.5)
+			{
+				REQUIRE(ring.GetPixel({ x, y }) == 0);
+			}
+			else if (distance >= 18.5 && distance <= 21.5)
+			{
+				REQUIRE(ring.GetPixel({ x, y }) == 1);
+			}
+		}
+	}
+}
+TEST_CASE("tile visitor reads pixels without unsharing")
+{
+	Image img = MakeGradient({ 21, 13 });
+	img.SetTile(3, CoW<Tile>{ 0x123456 });
+	const Image copy = img;
+
+	std::vector<uint32_t> seen(21 * 13, 0);
+	size_t tiles = 0;
+	std::as_const(img).ForEachTile([&](const TilePixels<const uint32_t>& tile) {
+		++tiles;
+		REQUIRE(tile.origin.x % Tile::SIZE == 0);
+		REQUIRE(tile.size.width == std::min<int>(Tile::SIZE, 21 - tile.origin.x));
+		for (int y = 0; y < tile.size.height; ++y)
+		{
+			for (int x = 0; x < tile.size.width; ++x)
+			{
+				seen[static_cast<size_t>((tile.origin.y + y) * 21 + tile.origin.x + x)] = tile.GetRow(y)[x];
+			}
+		}
+	});
+	REQUIRE(tiles == img.GetTileCount());
+	for (int y = 0; y < 13; ++y)
+	{
+		for (int x = 0; x < 21; ++x)
+		{
+			REQUIRE(seen[static_cast<size_t>(y * 21 + x)] == img.GetPixel({ x, y }));
+		}
+	}
+	REQUIRE(img.GetChangedTiles(copy).empty());
+	// одноцветный тайл остался свёрнутым
+	REQUIRE(img.GetTile(3)->IsSolid());
+}
+
+TEST_CASE("mutable visitors unshare each tile once")
+{
+	const Image original = MakeGradient({ 21, 13 });
+	Image img = original;
+	const int before = Tile::GetInstanceCount();
+	img.ForEachTile([](const TilePixels<uint32_t>& tile) {
+		for (int y = 0; y < tile.size.height; ++y)
+		{
+			uint32_t* row = tile.GetRow(y);
+			for (int x = 0; x < tile.size.width; ++x)
+			{
+				row[x] = ~row[x];
+			}
+		}
+	});
+	REQUIRE(Tile::GetInstanceCount() == before + static_cast<int>(img.GetTileCount()));
+	REQUIRE(img.GetDirtyTiles().size() == img.GetTileCount());
+	REQUIRE(img.GetPixel({ 20, 12 }) == ~original.GetPixel({ 20, 12 }));
+	REQUIRE(original.GetPixel({ 20, 12 }) == MakeGradient({ 21, 13 }).GetPixel({ 20, 12 }));
+
+	// строки обходятся сверху вниз, куски строки - слева направо
+	Image rows({ 21, 13 }, 7);
+	Point expected{ 0, 0 };
+	rows.ForEachRow([&](Point start, uint32_t* pixels, size_t count) {
+		REQUIRE(start.x == expected.x);
+		REQUIRE(start.y == expected.y);
+		for (size_t i = 0; i < count; ++i)
+		{
+			REQUIRE(pixels[i] == 7);
+			pixels[i] = static_cast<uint32_t>(start.y * 100 + start.x + static_cast<int>(i));
+		}
+		expected.x += static_cast<int>(count);
+		if (expected.x == 21)
+		{
+			expected = { 0, expected.y + 1 };
+		}
+	});
+	REQUIRE(expected.y == 13);
+	REQUIRE(rows.GetPixel({ 17, 9 }) == 917);
+
+	std::ostringstream printed;
+	PrintImage(LoadImage("ab\nc"), printed);
+	REQUIRE(printed.str() == std::string("ab\nc") + '\0' + "\n");
+}
+TEST_CASE("flood fill matches a breadth-first reference")
+{
+	std::mt19937 rng{ 11 };
+	const ImageSize size{ 37, 29 };
+	for (int iteration = 0; iteration < 60; ++iteration)
+	{
+		// крупные пятна нескольких близких цветов
+		Image img(size, 0x101010);
+		std::uniform_int_distribution<int> coord{ 0, 36 };
+		std::uniform_int_distribution<uint32_t> shade{ 0, 6 };
+		for (int i = 0; i < 25; ++i)
+		{
+			const Point a{ coord(rng), coord(rng) % 29 };
+			const uint32_t gray = 0x10 + shade(rng) * 3;
+			img.FillRect(a, { a.x + coord(rng) / 4, a.y + coord(rng) / 6 }, gray << 16 | gray << 8 | gray);
+		}
+		const Point seed{ coord(rng), coord(rng) % 29 };
+		const unsigned tolerance = static_cast<unsigned>(iteration % 3) * 4;
+		const Image original = img;
+		FloodFill(img, seed, 0xFF0000, tolerance);
+
+		const uint32_t seedColor = original.GetPixel(seed);
+		auto similar = [&](Point p) {
+			const uint32_t c = original.GetPixel(p);
+			for (int shift = 0; shift < 32; shift += 8)
+			{
+				if (static_cast<unsigned>(std::abs(static_cast<int>(c >> shift & 0xFF) - static_cast<int>(seedColor >> shift & 0xFF))) > tolerance) return false;
+			}
+			return true;
+		};
+		std::vector<bool> inside(static_cast<size_t>(size.width * size.height), false);
+		std::vector<Point> queue{ seed };
+		inside[static_cast<size_t>(seed.y * size.width + seed.x)] = true;
+		for (size_t i = 0; i < queue.size(); ++i)
+		{
+			const Point p = queue[i];
+			for (Point n : { Point{ p.x + 1, p.y }, Point{ p.x - 1, p.y }, Point{ p.x, p.y + 1 }, Point{ p.x, p.y - 1 } })
+			{
+				if (!IsPointInImage(n, size) || inside[static_cast<size_t>(n.y * size.width + n.x)] || !similar(n)) continue;
+				inside[static_cast<size_t>(n.y * size.width + n.x)] = true;
+				queue.push_back(n);
+			}
+		}
+
+		for (int y = 0; y < size.height; ++y)
+		{
+			for (int x = 0; x < size.width; ++x)
+			{
+				const bool filled = inside[static_cast<size_t>(y * size.width + x)];
+				REQUIRE(img.GetPixel({ x, y }) == (filled ? 0xFF0000 : original.GetPixel({ x, y })));
+			}
+		}
+		// тайлы без заливки остались общими с исходным изображением
+		for (size_t index : img.GetChangedTiles(original))
+		{
+			REQUIRE(img.IsTileDirty(index));
+		}
+	}
+}
+
+TEST_CASE("flood fill assigns whole tiles on uniform regions")
+{
+	Image img({ 512, 512 }, 0);
+	img.FillRect({ 100, 0 }, { 100, 511 }, 1);
+	const int before = Tile::GetInstanceCount();
+	FloodFill(img, { 5, 5 }, 2);
+
+	REQUIRE(img.GetPixel({ 99, 300 }) == 2);
+	REQUIRE(img.GetPixel({ 100, 300 }) == 1);
+	REQUIRE(img.GetPixel({ 101, 300 }) == 0);
+	// левая часть целиком из одноцветных тайлов, развёрнуты только тайлы у границы
+	for (size_t index = 0; index < img.GetTileCount(); ++index)
+	{
+		if (index % 64 < 12)
+		{
+			REQUIRE(img.GetTile(index)->IsSolid());
+		}
+	}
+	REQUIRE(Tile::GetInstanceCount() - before <= 12 * 64);
+
+	// та же заливка без допуска ничего не делает
+	const Image copy = img;
+	FloodFill(img, { 5, 5 }, 2);
+	FloodFill(img, { -1, 5 }, 3);
+	REQUIRE(img.GetChangedTiles(copy).empty());
+}
+
+TEST_CASE("flood fill follows a long serpentine corridor")
+{
+	// коридор-змейка через всё изображение: рекурсивная заливка переполнила бы стек
+	const ImageSize size{ 1000, 1000 };
+	Image img(size, 0);
+	for (int y = 1; y < size.height; y += 2)
+	{
+		const bool gapRight = (y / 2) % 2 == 0;
+		img.FillSpan(y, gapRight ? 0 : 1, gapRight ? size.width - 2 : size.width - 1, 1);
+	}
+	FloodFill(img, { 0, 0 }, 5);
+	REQUIRE(img.GetPixel({ 0, size.height - 1 }) == 5);
+	REQUIRE(img.GetPixel({ size.width - 1, 1 }) == 5);
+	REQUIRE(img.GetPixel({ 0, 1 }) == 1);
+
+	// допуск захватывает соседний оттенок
+	Image shades({ 20, 1 }, 0x808080);
+	shades.FillSpan(0, 10, 19, 0x828282);
+	Image strict = shades;
+	FloodFill(shades, { 0, 0 }, 0, 2);
+	FloodFill(strict, { 0, 0 }, 0, 1);
+	REQUIRE(shades.GetPixel({ 19, 0 }) == 0);
+	REQUIRE(strict.GetPixel({ 19, 0 }) == 0x828282);
+	REQUIRE(strict.GetPixel({ 9, 0 }) == 0);
+}
+
+namespace
+{
+	// пиксель уменьшенного вдвое изображения, посчитанный по определению фильтра
+	uint32_t DownsampledPixel(const Image& src, Point p, PyramidFilter filter)
+	{
+		const auto size = src.GetImageSize();
+		const bool bilinear = filter == PyramidFilter::Bilinear;
+		const int weights[4]{ 1, 3, 3, 1 };
+		const int taps = bilinear ? 4 : 2;
+		const int first = bilinear ? -1 : 0;
+		const int total = bilinear ? 64 : 4;
+
+		uint32_t result = 0;
+		for (int shift = 0; shift < 32; shift += 8)
+		{
+			int sum = 0;
+			for (int dy = 0; dy < taps; ++dy)
+			{
+				for (int dx = 0; dx < taps; ++dx)
+				{
+					const int x = std::clamp(2 * p.x + first + dx, 0, size.width - 1);
+					const int y = std::clamp(2 * p.y + first + dy, 0, size.height - 1);
+					const int weight = bilinear ? weights[dy] * weights[dx] : 1;
+					sum += weight * static_cast<int>(src.GetPixel({ x, y }) >> shift & 0xFF);
+				}
+			}
+			result |= static_cast<uint32_t>((sum + total / 2) / total) << shift;
+		}
+		return result;
+	}
+
+	void RequireDownsampled(const Image& src, const Image& level, PyramidFilter filter)
+	{
+		REQUIRE(level.GetImageSize().width == (src.GetImageSize().width + 1) / 2);
+		REQUIRE(level.GetImageSize().height == (src.GetImageSize().height + 1) / 2);
+		for (int y = 0; y < level.GetImageSize().height; ++y)
+		{
+			for (int x = 0; x < level.GetImageSize().width; ++x)
+			{
+				REQUIRE(level.GetPixel({ x, y }) == DownsampledPixel(src, { x, y }, filter));
+			}
+		}
+	}
+}
+
+TEST_CASE("pyramid levels halve the image with box and bilinear filters")
+{
+	Image img = MakeGradient({ 45, 27 });
+	img.SetPixel({ 3, 4 }, 0x80FFFFFF);
+	img.FillRect({ 16, 8 }, { 40, 26 }, 0xFF204060);
+
+	for (auto filter : { PyramidFilter::Box, PyramidFilter::Bilinear })
+	{
+		const auto& levels = img.BuildPyramid(filter);
+		REQUIRE(levels.size() == img.GetPyramidDepth());
+		REQUIRE(levels.size() == 6);
+		REQUIRE(levels.back().GetImageSize().width == 1);
+		REQUIRE(levels.back().GetImageSize().height == 1);
+
+		RequireDownsampled(img, levels[0], filter);
+		for (size_t level = 1; level < levels.size(); ++level)
+		{
+			RequireDownsampled(levels[level - 1], levels[level], filter);
+		}
+		REQUIRE(&img.GetPyramidLevel(0, filter) == &img);
+		REQUIRE(&img.GetPyramidLevel(2, filter) == &levels[1]);
+	}
+	REQUIRE_THROWS_AS(img.GetPyramidLevel(7), std::out_of_range);
+}
+
+TEST_CASE("pyramid rebuild keeps tiles of unchanged sources")
+{
+	for (auto filter : { PyramidFilter::Box, PyramidFilter::Bilinear })
+	{
+		Image img = MakeGradient({ 64, 64 });
+		// правая половина одноцветная
+		img.FillRect({ 32, 0 }, { 63, 63 }, 0x445566);
+		const auto before = img.BuildPyramid(filter);
+
+		// одноцветные области дают одни и те же одноцветные тайлы
+		REQUIRE(before[0].GetTile(3)->IsSolid());
+		REQUIRE(before[0].GetTile(3).IsSharedWith(before[0].GetTile(7)));
+
+		// тайл (1, 1) исходного изображения попадает в тайл (0, 0) первого уровня,
+		// билинейный фильтр задевает ещё и соседний по краю тайл (1, 0)
+		img.SetPixel({ 9, 9 }, 0xFFFFFF);
+		const auto& after = img.BuildPyramid(filter);
+		RequireDownsampled(img, after[0], filter);
+
+		if (filter == PyramidFilter::Box)
+		{
+			REQUIRE(after[0].GetChangedTiles(before[0]) == std::vector<size_t>{ 0 });
+			REQUIRE(after[1].GetChangedTiles(before[1]) == std::vector<size_t>{ 0 });
+		}
+		else
+		{
+			REQUIRE(after[0].GetChangedTiles(before[0]) == std::vector<size_t>{ 0, 1, 4, 5 });
+			REQUIRE(after[1].GetChangedTiles(before[1]) == std::vector<size_t>{ 0, 1, 2, 3 });
+		}
+		REQUIRE(after[2].GetChangedTiles(before[2]) == std::vector<size_t>{ 0 });
+
+		// без изменений повторный запрос ничего не пересчитывает
+		const auto again = img.BuildPyramid(filter);
+		REQUIRE(again[0].GetChangedTiles(after[0]).empty());
+	}
+}
+
+TEST_CASE("pyramid of a solid image is built from shared solid tiles")
+{
+	const Image img{ { 1000, 600 }, 0xFF336699 };
+	const auto before = Tile::GetInstanceCount();
+	const auto& levels = img.BuildPyramid(PyramidFilter::Bilinear);
+	// по одному общему тайлу на уровень
+	REQUIRE(Tile::GetInstanceCount() - before == static_cast<int>(levels.size()));
+	REQUIRE(levels[2].GetPixel({ 100, 70 }) == 0xFF336699);
+}
+
+TEST_CASE("view reads a part of the image without copying")
+{
+	const Image img = MakeGradient({ 30, 20 });
+	const auto tiles = Tile::GetInstanceCount();
+	const ImageView view = img.View({ { 5, 3 }, { 17, 11 } });
+	REQUIRE(Tile::GetInstanceCount() == tiles);
+	REQUIRE(view.GetImageSize().width == 17);
+	REQUIRE(view.GetPixel({ 0, 0 }) == img.GetPixel({ 5, 3 }));
+	REQUIRE(view.GetPixel({ 16, 10 }) == img.GetPixel({ 21, 13 }));
+	REQUIRE(view.GetPixel({ 17, 0 }) == 0);
+
+	// куски строк обрезаны по виду и покрывают его ровно один раз
+	std::vector<int> visits(17 * 11);
+	view.ForEachRow([&](Point start, const uint32_t* pixels, size_t count) {
+		for (size_t i = 0; i < count; ++i)
+		{
+			const Point p{ start.x + static_cast<int>(i), start.y };
+			REQUIRE(IsPointInImage(p, view.GetImageSize()));
+			REQUIRE(pixels[i] == view.GetPixel(p));
+			++visits[static_cast<size_t>(p.y * 17 + p.x)];
+		}
+	});
+	REQUIRE(std::all_of(visits.begin(), visits.end(), [](int n) { return n == 1; }));
+
+	const ImageView inner = view.View({ { 2, 1 }, { 4, 4 } });
+	REQUIRE(inner.GetRect().origin.x == 7);
+	REQUIRE(inner.GetPixel({ 3, 3 }) == img.GetPixel({ 10, 7 }));
+	RequireSamePixels(inner.Crop(), img.Crop({ { 7, 4 }, { 4, 4 } }));
+
+	REQUIRE_THROWS_AS(img.View({ { 20, 0 }, { 11, 5 } }), std::out_of_range);
+	REQUIRE_THROWS_AS(img.View({ { 0, 0 }, { 0, 5 } }), std::out_of_range);
+	REQUIRE_THROWS_AS(view.View({ { 10, 0 }, { 8, 5 } }), std::out_of_range);
+}
+
+TEST_CASE("tile-aligned crop shares tiles, unaligned crop copies pixels")
+{
+	const Image img = MakeGradient({ 40, 30 });
+	const auto tiles = Tile::GetInstanceCount();
+
+	// 19 x 13: краевые тайлы тоже общие, лишние пиксели лежат за границей
+	const Image aligned = img.Crop({ { 8, 16 }, { 19, 13 } });
+	REQUIRE(Tile::GetInstanceCount() == tiles);
+	REQUIRE(aligned.GetTile(0).IsSharedWith(img.GetTile(2 * 5 + 1)));
+	REQUIRE(aligned.GetTile(5).IsSharedWith(img.GetTile(3 * 5 + 3)));
+	REQUIRE(aligned.GetDirtyTiles().empty());
+	for (int y = 0; y < 13; ++y)
+	{
+		for (int x = 0; x < 19; ++x)
+		{
+			REQUIRE(aligned.GetPixel({ x, y }) == img.GetPixel({ x + 8, y + 16 }));
+		}
+	}
+
+	const Image unaligned = img.Crop({ { 3, 5 }, { 30, 20 } });
+	RequireSamePixels(unaligned, img.View({ { 3, 5 }, { 30, 20 } }).Crop());
+	REQUIRE(unaligned.GetPixel({ 29, 19 }) == img.GetPixel({ 32, 24 }));
+}
+
+TEST_CASE("tile-aligned paste shares covered tiles and copies edge tiles")
+{
+	const Image src = MakeGradient({ 20, 12 });
+	Image img{ { 40, 30 }, 0xABCDEF };
+	Image reference = img;
+	img.Paste(src, { 16, 8 });
+	reference.Blit(src, { 16, 8 });
+	RequireSamePixels(img, reference);
+
+	// тайл (2, 1) закрыт src целиком, (4, 1) и (2, 2) - только частично
+	REQUIRE(img.GetTile(1 * 5 + 2).IsSharedWith(src.GetTile(0)));
+	REQUIRE(img.GetTile(1 * 5 + 3).IsSharedWith(src.GetTile(1)));
+	REQUIRE(!img.GetTile(1 * 5 + 4).IsSharedWith(src.GetTile(2)));
+	REQUIRE(!img.GetTile(2 * 5 + 2).IsSharedWith(src.GetTile(3)));
+	REQUIRE(img.GetPixel({ 36, 8 }) == 0xABCDEF);
+
+	// у правого и нижнего края изображения краевой тайл src закрывает видимую часть
+	Image corner{ { 28, 19 } };
+	corner.Paste(src, { 24, 16 });
+	REQUIRE(corner.GetTile(2 * 4 + 3).IsSharedWith(src.GetTile(0)));
+	REQUIRE(corner.GetPixel({ 27, 18 }) == src.GetPixel({ 3, 2 }));
+
+	// отрицательный сдвиг и невыровненная вставка
+	Image shifted{ { 40, 30 } };
+	Image blitted = shifted;
+	shifted.Paste(src, { -8, 0 });
+	blitted.Blit(src, { -8, 0 });
+	RequireSamePixels(shifted, blitted);
+	REQUIRE(shifted.GetTile(0).IsSharedWith(src.GetTile(1)));
+
+	shifted.Paste(src, { 5, 3 });
+	blitted.Blit(src, { 5, 3 });
+	RequireSamePixels(shifted, blitted);
+}
+
+TEST_CASE("paged image matches an in-memory image under a small budget")
+{
+	const ImageSize size{ 75, 61 };
+	Image reference{ size, 0x102030 };
+	{
+		// четыре развёрнутых тайла в памяти
+		PagedImage paged{ "test_paged.bin", size, 4 * PagedImage::TileStore::TILE_BYTES, 0x102030 };
+		REQUIRE(paged.GetStore().GetCapacity() == 4);
+
+		std::mt19937 rng{ 5 };
+		std::uniform_int_distribution<int> xs{ -2, size.width + 1 };
+		std::uniform_int_distribution<int> ys{ -2, size.height + 1 };
+		for (int i = 0; i < 3000; ++i)
+		{
+			const Point p{ xs(rng), ys(rng) };
+			const auto color = static_cast<uint32_t>(rng());
+			switch (i % 10)
+			{
+			case 0:
+			{
+				const Point to{ xs(rng), ys(rng) };
+				paged.FillRect(p, to, color);
+				reference.FillRect(p, to, color);
+				break;
+			}
+			case 1:
+			{
+				if (p.y < 0 || p.y >= size.height) break;
+				std::vector<uint32_t> row(static_cast<size_t>(size.width), color);
+				row[static_cast<size_t>(i) % row.size()] = ~color;
+				paged.WriteRow(p.y, row.data());
+				reference.WriteRow(p.y, row.data());
+				break;
+			}
+			default:
+				paged.SetPixel(p, color);
+				reference.SetPixel(p, color);
+			}
+			REQUIRE(paged.GetPixel(p) == reference.GetPixel(p));
+		}
+		REQUIRE(paged.GetStore().GetResidentTileCount() <= 4);
+
+		std::vector<uint32_t> row(static_cast<size_t>(size.width));
+		std::vector<uint32_t> expected(row.size());
+		for (int y = 0; y < size.height; ++y)
+		{
+			paged.ReadRow(y, row.data());
+			reference.ReadRow(y, expected.data());
+			REQUIRE(row == expected);
+		}
+
+		const auto stats = paged.GetStats();
+		REQUIRE(stats.misses > 0);
+		REQUIRE(stats.hits > 0);
+		REQUIRE(stats.writeBacks > 0);
+	}
+
+	// разрушение записало изменённые тайлы, файл открывается заново
+	PagedImage reopened{ "test_paged.bin", 1 };
+	REQUIRE(reopened.GetStore().GetCapacity() == 1);
+	for (int y = 0; y < size.height; ++y)
+	{
+		for (int x = 0; x < size.width; ++x)
+		{
+			REQUIRE(reopened.GetPixel({ x, y }) == reference.GetPixel({ x, y }));
+		}
+	}
+	REQUIRE(reopened.GetStats().writeBacks == 0);
+	std::remove("test_paged.bin");
+}
+
+TEST_CASE("drawing functions draw on a paged image like on an in-memory one")
+{
+	const ImageSize size{ 70, 50 };
+	Image reference{ size, 0x101010 };
+	{
+		PagedImage paged{ "test_paged_draw.bin", size, 4 * PagedImage::TileStore::TILE_BYTES, 0x101010 };
+		const auto draw = [](auto& img) {
+			DrawLine(img, { -5, 3 }, { 66, 47 }, 0xFF0000);
+			DrawCircle(img, { 30, 25 }, 20, 0x00FF00);
+			FillCircle(img, { 50, 12 }, 9, 0x0000FF);
+			FillPolygon(img, { { 2, 40 }, { 30, 30 }, { 20, 49 }, { 5, 30 } }, 0xFFFF00, FillRule::NonZero);
+			DrawLineAA(img, { 0, 49 }, { 69, 0 }, 0xFFFFFF);
+			DrawThickCircle(img, { 10, 10 }, 8, 3, 0x00FFFF);
+			// область внутри окружности ограничена линиями и фигурами
+			FloodFill(img, { 30, 25 }, 0xFF00FF);
+			FloodFill(img, { 68, 48 }, 0x202020, 16);
+		};
+		draw(paged);
+		draw(reference);
+
+		REQUIRE(paged.GetStore().GetResidentTileCount() <= 4);
+		for (int y = 0; y < size.height; ++y)
+		{
+			for (int x = 0; x < size.width; ++x)
+			{
+				REQUIRE(paged.GetPixel({ x, y }) == reference.GetPixel({ x, y }));
+			}
+		}
+	}
+	std::remove("test_paged_draw.bin");
+}
+
+TEST_CASE("paged store evicts least recently used tiles and writes back only dirty ones")
+{
+	{
+		BasicPagedTileStore<8> store{ "test_paged_lru.bin", { 32, 8 }, 2 * BasicPagedTileStore<8>::TILE_BYTES };
+		store.WriteTile(0).SetPixel({ 1, 1 }, 7);
+		store.ReadTile(1);
+		store.ReadTile(0);
+		// вытесняется тайл 1: он не менялся и не записывается
+		store.ReadTile(2);
+		REQUIRE(store.GetStats().writeBacks == 0);
+		// теперь вытесняется изменённый тайл 0
+		store.ReadTile(3);
+		REQUIRE(store.GetStats().writeBacks == 1);
+		REQUIRE(store.GetStats().misses == 4);
+		REQUIRE(store.GetStats().hits == 1);
+
+		REQUIRE(store.ReadTile(0).GetPixel({ 1, 1 }) == 7);
+		// закрашенный целиком тайл не читается из файла
+		store.ResetStats();
+		store.SetTile(1, BasicTile<8>{ 9 });
+		REQUIRE(store.GetStats().misses == 0);
+		store.Flush();
+		REQUIRE(store.GetStats().writeBacks == 1);
+		REQUIRE_THROWS_AS(store.ReadTile(4), std::out_of_range);
+	}
+
+	std::remove("test_paged_lru.bin");
+
+	// 2^20 x 2^20 пикселей: 2^34 тайлов, индексы и смещения не помещаются в 32 бита
+	{
+		PagedImage huge{ "test_paged_huge.bin", { 1 << 20, 1 << 20 }, 1 << 20, 0xFF0000 };
+		REQUIRE(huge.GetStore().GetTileCount() == uint64_t{ 1 } << 34);
+		huge.SetPixel({ 3, 3 }, 0x00FF00);
+		REQUIRE(huge.GetPixel({ (1 << 20) - 1, (1 << 20) - 1 }) == 0xFF0000);
+		REQUIRE(huge.GetPixel({ 3, 3 }) == 0x00FF00);
+	}
+	std::remove("test_paged_huge.bin");
 }
\ No newline at end of file